@@ -23,6 +23,7 @@
 #include "chess_types.h"
 #include "core.h"
 #include "hashkey.h"
+#include "nnue.h"
 #include "strview.h"
 
 // Struct representing the board stack data from past moves
@@ -57,6 +58,11 @@ typedef struct {
     Square castling_rook_square[CASTLING_NB];
     Bitboard castling_path[CASTLING_NB];
     Boardstack *stack;
+
+    // Current NNUE accumulator, or NULL if the board doesn't track one. Moves push a new
+    // accumulator right after the current one, so this must point into an array large enough to
+    // hold one accumulator per ply.
+    NnueAccumulator *accumulator;
     u16 ply;
     Color side_to_move;
     Scorepair psq_scorepair;
@@ -83,6 +89,10 @@ void boardstack_destroy(Boardstack *stack);
 // was correctly initialized, false otherwise.
 bool board_try_init(Board *board, StringView fen, bool is_chess960, Boardstack *stack);
 
+// Returns the FEN part of an EPD or FEN line: the four mandatory fields, followed by the move
+// counters when they are present.
+StringView board_fen_from_epd(StringView line);
+
 // Clones a board and its stack into another board struct
 void board_clone(Board *restrict board, const Board *restrict other);
 
@@ -106,6 +116,10 @@ void board_do_move_gc(
     bool gives_check
 );
 
+// Computes the board key of the position after the given legal move, without applying it. This is
+// mostly useful for prefetching TT entries ahead of time
+Key board_key_after(const Board *board, Move move);
+
 // Applies a legal move to the board
 INLINED void board_do_move(Board *restrict board, Move move, Boardstack *restrict new_stack) {
     board_do_move_gc(board, move, new_stack, board_move_gives_check(board, move));
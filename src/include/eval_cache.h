@@ -0,0 +1,83 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EVAL_CACHE_H
+#define EVAL_CACHE_H
+
+#include "chess_types.h"
+#include "core.h"
+#include "hashkey.h"
+
+enum {
+    // Default size of the per-worker eval caches in KB, which holds 32768 entries
+    EVAL_CACHE_DEFAULT_KB = 256,
+};
+
+// Struct for an eval cache entry. The upper 48 bits of the position key are packed with the raw
+// eval in a single word, the lower bits being implied by the entry index.
+typedef struct {
+    u64 data;
+} EvalCacheEntry;
+
+// Struct for the eval cache, which remembers the raw evals of the positions recently evaluated by
+// a worker. The entry count is always zero or a power of two, so that entries can be indexed by
+// masking the key.
+typedef struct {
+    EvalCacheEntry *entries;
+    usize entry_count;
+} EvalCache;
+
+// Initializes an empty, disabled eval cache
+void eval_cache_init(EvalCache *cache);
+
+// Frees the memory associated with the eval cache
+void eval_cache_destroy(EvalCache *cache);
+
+// Resizes the eval cache to the largest power-of-two entry count fitting in the given size. A size
+// of zero disables it. The cache must be cleared before use
+void eval_cache_resize(EvalCache *cache, usize size_kb);
+
+// Removes all entries from the eval cache
+void eval_cache_clear(EvalCache *cache);
+
+// Looks up the raw eval of the position with the given key. Returns true on a hit
+INLINED bool eval_cache_probe(EvalCache *cache, Key key, Score *eval) {
+    if (cache->entry_count == 0) {
+        return false;
+    }
+
+    const u64 data = cache->entries[key & (cache->entry_count - 1)].data;
+
+    // Zeroed entries are empty. This only hides positions whose key has its upper 48 bits clear and
+    // whose eval is zero.
+    if (data == 0 || (data ^ key) >> 16 != 0) {
+        return false;
+    }
+
+    *eval = (Score)(i16)(u16)data;
+    return true;
+}
+
+// Stores the raw eval of the position with the given key
+INLINED void eval_cache_store(EvalCache *cache, Key key, Score eval) {
+    if (cache->entry_count != 0) {
+        cache->entries[key & (cache->entry_count - 1)].data = (key & ~(u64)0xFFFF) | (u16)eval;
+    }
+}
+
+#endif
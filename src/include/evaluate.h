@@ -180,4 +180,14 @@ INLINED void trace_clear_safety(Color us) {
 
 Score evaluate(const Board *board);
 
+// Sets the margin used by evaluate_in_window() for skipping the expensive evaluation terms. A
+// margin of zero disables the lazy evaluation.
+void evaluate_set_lazy_margin(Score margin);
+
+// Evaluates the position like evaluate(), except that the evaluation can stop early when the
+// material, PSQ and King-Pawn structure terms alone are further than the lazy margin away from the
+// [alpha, beta] window, given relative to the side to move. In that case the partial score is
+// returned, and `exact` is set to false.
+Score evaluate_in_window(const Board *board, Score alpha, Score beta, bool *exact);
+
 #endif
@@ -22,7 +22,8 @@
 #include "board.h"
 
 enum {
-    KING_PAWN_ENTRY_NB = 32768,
+    // Default size of the per-worker King-Pawn tables in KB, which holds 32768 entries
+    KING_PAWN_DEFAULT_KB = 1536,
 };
 
 // Struct for pawn eval data
@@ -33,8 +34,11 @@ typedef struct {
     Scorepair value;
 } KingPawnEntry;
 
+// Struct for the King-Pawn table. The entry count is always a power of two, so that entries can be
+// indexed by masking the key.
 typedef struct {
-    KingPawnEntry entry[KING_PAWN_ENTRY_NB];
+    KingPawnEntry *entries;
+    usize entry_count;
 } KingPawnTable;
 
 // Struct for local pawn eval data
@@ -43,7 +47,23 @@ typedef struct {
     Bitboard attacks2[COLOR_NB];
 } PawnLocalData;
 
-static_assert(sizeof(KingPawnTable) % 64 == 0, "Misaligned King-Pawn table");
+// Initializes an empty King-Pawn table
+void king_pawn_table_init(KingPawnTable *table);
+
+// Frees the memory associated with the King-Pawn table
+void king_pawn_table_destroy(KingPawnTable *table);
+
+// Resizes the King-Pawn table to the largest power-of-two entry count fitting in the given size.
+// The table always holds at least one entry, and must be cleared before use
+void king_pawn_table_resize(KingPawnTable *table, usize size_kb);
+
+// Removes all entries from the King-Pawn table
+void king_pawn_table_clear(KingPawnTable *table);
+
+// Returns the King-Pawn table entry for the given hashkey
+INLINED KingPawnEntry *king_pawn_entry_at(KingPawnTable *table, Key key) {
+    return &table->entries[key & (table->entry_count - 1)];
+}
 
 // Probes the King-Pawn hash table for the given position.
 KingPawnEntry *king_pawn_probe(const Board *board);
@@ -0,0 +1,54 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include "board.h"
+#include "endgame.h"
+
+enum {
+    MATERIAL_ENTRY_NB = 8192,
+};
+
+// Struct for the evaluation data that only depends on the material configuration
+typedef struct {
+    Key key;
+    const EndgameEntry *score_entry;
+    const EndgameEntry *scale_entry;
+    i16 phase;
+    Color kxk_side;
+} MaterialEntry;
+
+typedef struct {
+    MaterialEntry entry[MATERIAL_ENTRY_NB];
+} MaterialTable;
+
+static_assert(sizeof(MaterialTable) % 64 == 0, "Misaligned material table");
+
+// Returns the material table entry for the given hashkey
+INLINED MaterialEntry *material_entry_at(MaterialTable *table, Key key) {
+    return &table->entry[key % MATERIAL_ENTRY_NB];
+}
+
+// Probes the material hash table for the given position. The entry holds the specialized scoring
+// and scaling endgames (or NULL if there are none), the game phase, and the strong side of a KXK
+// endgame (or COLOR_NB if this isn't one).
+const MaterialEntry *material_probe(const Board *board);
+
+#endif
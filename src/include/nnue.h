@@ -0,0 +1,87 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "chess_types.h"
+#include "core.h"
+
+enum {
+    // Network file format version. Files with another version are rejected
+    NNUE_VERSION = 1,
+
+    // Network topology: 768 piece-square inputs per perspective, fully connected to a hidden layer
+    // shared by both perspectives, whose clipped outputs are concatenated and fed to one output
+    NNUE_INPUT_SIZE = 768,
+    NNUE_HIDDEN_SIZE = 256,
+
+    // Quantization factors of the hidden and output layers, and the scale of the output
+    NNUE_QA = 255,
+    NNUE_QB = 64,
+    NNUE_OUTPUT_SCALE = 400,
+};
+
+// Struct for the hidden layer values of both perspectives. They are updated incrementally as moves
+// are played, so that only the output layer needs to be computed at evaluation time.
+typedef struct {
+    _Alignas(64) i16 values[COLOR_NB][NNUE_HIDDEN_SIZE];
+} NnueAccumulator;
+
+// Enum for the outcome of a network load
+typedef enum {
+    NnueLoadOk,
+    NnueLoadOpenFailed,
+    NnueLoadBadHeader,
+    NnueLoadBadVersion,
+    NnueLoadBadTopology,
+    NnueLoadTruncated,
+} NnueLoadStatus;
+
+// Loads the network from the given file. The previous network is kept if the load fails
+NnueLoadStatus nnue_load(const char *filename);
+
+// Returns a short description of the load status
+const char *nnue_load_status_name(NnueLoadStatus status);
+
+// Frees the current network
+void nnue_unload(void);
+
+// Enables/disables the usage of the network in the evaluation. Enabling it without a loaded network
+// has no effect, the classical evaluation is used instead.
+void nnue_set_enabled(bool state);
+
+// Returns true if the network is enabled and loaded
+bool nnue_is_active(void);
+
+// Computes the accumulator from scratch for the given piece placement
+void nnue_accumulator_refresh(NnueAccumulator *accumulator, const Piece *mailbox);
+
+// Adds the given piece to the accumulator
+void nnue_accumulator_add(NnueAccumulator *accumulator, Piece piece, Square square);
+
+// Removes the given piece from the accumulator
+void nnue_accumulator_remove(NnueAccumulator *accumulator, Piece piece, Square square);
+
+// Moves the given piece in the accumulator
+void nnue_accumulator_move(NnueAccumulator *accumulator, Piece piece, Square from, Square to);
+
+// Computes the network output from the accumulator, relative to the side to move
+Score nnue_evaluate(const NnueAccumulator *accumulator, Color side_to_move);
+
+#endif
@@ -0,0 +1,74 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NUMA_H
+#define NUMA_H
+
+#include "core.h"
+#include "strview.h"
+
+enum {
+    NUMA_MAX_NODES = 64,
+};
+
+// Enum for the CPU pinning strategies of worker threads
+typedef enum {
+    ThreadBindingNone,
+    ThreadBindingCompact,
+    ThreadBindingScatter,
+    ThreadBindingNoSmt,
+    ThreadBindingList,
+} ThreadBinding;
+
+// Discovers the NUMA and CPU layout of the host
+void numa_init(void);
+
+// Enables/disables NUMA-aware thread and memory placement. This has no effect on single-node hosts
+void numa_set_enabled(bool state);
+
+// Returns true if NUMA-aware placement is enabled and the host has more than one node
+bool numa_is_active(void);
+
+// Returns the number of NUMA nodes available to the process
+usize numa_node_count(void);
+
+// Returns the number of CPUs available to the process, or 1 if it is unknown
+usize numa_cpu_count(void);
+
+// Sets how worker threads get pinned to CPUs. Compact fills each core and node before moving to the
+// next one, Scatter spreads threads over nodes and physical cores first, NoSmt only uses one CPU
+// per physical core, and List uses the CPUs of the given ID list (e.g. "0-3,8"). Returns false if
+// no usable CPU is left with this strategy, in which case pinning is disabled.
+bool numa_set_thread_binding(ThreadBinding binding, StringView cpu_list);
+
+// Returns the node a worker thread should be placed on, given its index in the pool
+usize numa_worker_node(usize worker_index);
+
+// Restricts the calling thread to the CPU assigned to the given worker if pinning is enabled, or
+// to the CPUs of its node otherwise
+void numa_bind_worker_thread(usize worker_index);
+
+// Asks for all pages of the given memory range to be placed on the given node. The range should not
+// have been accessed yet for the policy to apply.
+void numa_bind_memory(void *ptr, usize size, usize node);
+
+// Asks for all pages of the given memory range to be interleaved between all nodes. The range
+// should not have been accessed yet for the policy to apply.
+void numa_interleave_memory(void *ptr, usize size);
+
+#endif
@@ -0,0 +1,51 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PERFT_H
+#define PERFT_H
+
+#include <stdatomic.h>
+
+#include "board.h"
+
+// Struct for a perft hash entry. The check field holds the position key mixed with the depth and
+// the count, so that entries torn by concurrent writes from several threads are rejected.
+typedef struct {
+    _Atomic u64 check;
+    _Atomic u64 count;
+} PerftEntry;
+
+// Struct for the perft hash table, caching the leaf counts of subtrees. A NULL table disables
+// caching.
+typedef struct {
+    usize entry_count;
+    PerftEntry *table;
+} PerftTable;
+
+void perft_table_init(PerftTable *perft_table);
+
+void perft_table_destroy(PerftTable *perft_table);
+
+// Reallocates the table with the given size in MB. A size of zero disables the table
+void perft_table_resize(PerftTable *perft_table, usize size_mb);
+
+// Returns the number of leaf nodes at the given depth from the board position, using the perft
+// table (if enabled) to skip already counted subtrees
+u64 perft(Board *board, u16 depth, PerftTable *perft_table);
+
+#endif
@@ -19,10 +19,14 @@
 #ifndef SEARCH_H
 #define SEARCH_H
 
+#include "strmanip.h"
 #include "worker.h"
 
 void search_init(void);
 
+// Appends the score to the string in the UCI format ("cp <x>" or "mate <y>")
+void info_append_score(String *info_str, Score score, bool normalize);
+
 // Struct for holding search data
 typedef struct {
     i16 plies;
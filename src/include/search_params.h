@@ -42,8 +42,12 @@ typedef struct {
     Duration movetime;
     u16 mate;
     u16 perft;
+    bool divide;
     bool infinite;
     bool ponder;
+
+    // Disables all search output, for searches run by the engine itself rather than by the GUI
+    bool silent;
     Movelist searchmoves;
 } SearchParams;
 
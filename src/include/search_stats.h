@@ -0,0 +1,87 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+#include "core.h"
+
+#ifdef SEARCH_STATS
+// Struct for search event counters, only available when building with SEARCH_STATS=yes. Each worker
+// owns its counters, so they don't need to be atomic.
+typedef struct {
+    u64 search_nodes;
+    u64 qsearch_nodes;
+    u64 tt_cutoffs;
+    u64 razoring;
+    u64 futility;
+    u64 nmp_tries;
+    u64 nmp_cutoffs;
+    u64 nmp_verifications;
+    u64 nmp_verified;
+    u64 probcut_tries;
+    u64 probcut_searches;
+    u64 probcut_cutoffs;
+    u64 searched_moves;
+    u64 lmp;
+    u64 move_futility;
+    u64 conthist_pruning;
+    u64 see_pruning;
+    u64 singular_searches;
+    u64 singular_extensions;
+    u64 double_extensions;
+    u64 multicut;
+    u64 negative_extensions;
+    u64 check_extensions;
+    u64 lmr_searches;
+    u64 lmr_researches;
+    u64 qsearch_stand_pats;
+    u64 qsearch_futility;
+    u64 qsearch_see_pruning;
+    u64 qsearch_tt_probes;
+    u64 qsearch_tt_hits;
+    u64 evaluations;
+    u64 lazy_evaluations;
+    u64 eval_cache_probes;
+    u64 eval_cache_hits;
+    u64 king_pawn_probes;
+    u64 king_pawn_hits;
+} SearchStats;
+
+#define search_stats_inc(worker, counter) (++(worker)->search_stats.counter)
+
+#define search_stats_inc_if(worker, counter, condition)   \
+    do {                                                  \
+        (worker)->search_stats.counter += !!(condition); \
+    } while (0)
+
+// Resets all counters to zero
+void search_stats_reset(SearchStats *stats);
+
+// Adds the counters of the second struct to the first one
+void search_stats_add(SearchStats *restrict total, const SearchStats *restrict stats);
+
+// Prints the counters, along with the rate at which each pruning or extension fires
+void search_stats_show(const SearchStats *stats);
+#else
+// The counters compile out entirely, including the evaluation of their conditions.
+#define search_stats_inc(worker, counter) ((void)0)
+#define search_stats_inc_if(worker, counter, condition) ((void)0)
+#endif
+
+#endif
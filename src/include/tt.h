@@ -21,24 +21,48 @@
 
 #include "chess_types.h"
 #include "hashkey.h"
+#include "wmalloc.h"
 
 enum {
-    ENTRY_CLUSTER_SIZE = 4,
+    ENTRY_CLUSTER_SIZE = 6,
 
     GENERATION_SHIFT = 4,
     GENERATION_MASK = 256 - GENERATION_SHIFT,
     GENERATION_CYCLE = 256 + GENERATION_SHIFT - 1,
+
+    // Depths are stored with an offset, so that a stored depth of zero marks an empty slot.
+    TT_DEPTH_OFFSET = 1,
+
+    // Epoch used by all processes attached to a shared TT. It never changes, since a process
+    // starting a new epoch would make the clusters written by the other ones appear stale.
+    TT_SHARED_EPOCH = 1,
 };
 
+// Struct for a compact TT entry. Only 16 bits of the key are stored, since the cluster index is
+// already derived from its highest bits.
 typedef struct {
-    Key key;
+    u16 key16;
+    Move bestmove;
     Score score;
     Score eval;
     u8 depth;
     u8 genbound;
-    Move bestmove;
 } TranspositionEntry;
 
+// Returns the key fragment stored in TT entries. We avoid the lowest 16 bits of the key here, as
+// they're left untouched by the excluded move in singular searches.
+INLINED u16 tt_key16(Key key) {
+    return (u16)(key >> 16);
+}
+
+INLINED bool tt_entry_is_empty(const TranspositionEntry *tt_entry) {
+    return tt_entry->depth == 0;
+}
+
+INLINED i16 tt_entry_depth(const TranspositionEntry *tt_entry) {
+    return (i16)tt_entry->depth - TT_DEPTH_OFFSET;
+}
+
 INLINED i16 tt_entry_replace_score(const TranspositionEntry *tt_entry, u8 generation) {
     return (i16)tt_entry->depth
         - (((i16)GENERATION_CYCLE + (i16)generation - (i16)tt_entry->genbound) & GENERATION_MASK);
@@ -48,25 +72,78 @@ INLINED Bound tt_entry_bound(const TranspositionEntry *tt_entry) {
     return (Bound)(tt_entry->genbound & ~GENERATION_MASK);
 }
 
+// Struct for a cache line of TT entries. The epoch tag stores the lowest 32 bits of the table epoch
+// at the time the cluster was last written to, and all entries of clusters with an outdated tag are
+// considered empty.
 typedef struct {
     TranspositionEntry cluster_entry[ENTRY_CLUSTER_SIZE];
+    u32 epoch_tag;
 } TranspositionCluster;
 
 // Required for correct prefetching and structure alignment
-static_assert(
-    64 % sizeof(TranspositionCluster) == 0,
-    "Clusters are not aligned to cache boundaries"
-);
+static_assert(sizeof(TranspositionCluster) == 64, "Clusters do not match cache boundaries");
+
+#ifdef TT_STATS
+// Struct for TT usage counters, only available when building with TT_STATS=yes. Each worker owns
+// its counters, so they don't need to be atomic, and they are summed when reported. Functions
+// taking counters accept NULL for tables that aren't tracked.
+typedef struct TtStats {
+    u64 probes;
+    u64 hits;
+    u64 cutoffs;
+    u64 collisions;
+    u64 stale_clusters;
+    u64 replaced_empty;
+    u64 replaced_aged;
+    u64 replaced_shallower;
+    u64 updated_same_key;
+    u64 preserved_same_key;
+} TtStats;
+
+#define tt_stats_inc(stats, counter) tt_stats_inc_if(stats, counter, true)
+
+#define tt_stats_inc_if(stats, counter, condition) \
+    do {                                           \
+        if ((stats) != NULL) {                     \
+            (stats)->counter += !!(condition);     \
+        }                                          \
+    } while (0)
+
+// Resets all counters to zero
+void tt_stats_reset(TtStats *stats);
+
+// Adds the counters of the second struct to the first one
+void tt_stats_add(TtStats *restrict total, const TtStats *restrict stats);
+#else
+// Without TT_STATS, the counters are never defined and only NULL pointers are passed around. The
+// counters compile out entirely, including the evaluation of their conditions.
+typedef struct TtStats TtStats;
+
+#define tt_stats_inc(stats, counter) ((void)(stats))
+#define tt_stats_inc_if(stats, counter, condition) ((void)(stats))
+#endif
 
 typedef struct {
     usize cluster_count;
     TranspositionCluster *table;
+    PageKind page_kind;
     u8 generation;
+    bool lazy_clear;
+    u64 epoch;
 } TranspositionTable;
 
+INLINED u32 tt_epoch_tag(const TranspositionTable *tt) {
+    return (u32)tt->epoch;
+}
+
+// Returns true if the cluster was last written to before the last lazy clear
+INLINED bool tt_cluster_is_stale(const TranspositionTable *tt, const TranspositionCluster *cluster) {
+    return cluster->epoch_tag != tt_epoch_tag(tt);
+}
+
 // Returns the entry cluster for the given hashkey
-INLINED TranspositionEntry *tt_entry_at(TranspositionTable *tt, Key key) {
-    return tt->table[u64_mulhi(key, tt->cluster_count)].cluster_entry;
+INLINED TranspositionCluster *tt_cluster_at(TranspositionTable *tt, Key key) {
+    return &tt->table[u64_mulhi(key, tt->cluster_count)];
 }
 
 INLINED void tt_new_search(TranspositionTable *tt) {
@@ -89,15 +166,23 @@ void tt_init(TranspositionTable *tt);
 
 void tt_destroy(TranspositionTable *tt);
 
-// Clears the TT contents before starting a new game
+// Zeroes all TT entries
+void tt_clear(TranspositionTable *tt, usize thread_count);
+
+// Clears the TT contents before starting a new game. If lazy clearing is enabled, this only starts a
+// new epoch, invalidating all entries without touching the table.
 void tt_init_new_game(TranspositionTable *tt, usize thread_count);
 
+// Enables or disables lazy clearing. Shared tables always keep the fixed shared epoch
+void tt_set_lazy_clear(TranspositionTable *tt, bool lazy_clear);
+
 // Returns data matching the given key
-TranspositionEntry *tt_probe(TranspositionTable *tt, Key key, bool *found);
+TranspositionEntry *tt_probe(TranspositionTable *tt, TtStats *stats, Key key, bool *found);
 
 // Saves the given entry in the TT
 void tt_save(
     TranspositionTable *tt,
+    TtStats *stats,
     TranspositionEntry *tt_entry,
     Key key,
     Score score,
@@ -107,9 +192,45 @@ void tt_save(
     Move bestmove
 );
 
-// Returns the filled proportion of the TT (per mil).
+// Returns the filled proportion of the TT (per mil), estimated from clusters sampled evenly over the
+// whole table.
 u16 tt_hashfull(TranspositionTable *tt);
 
-void tt_resize(TranspositionTable *tt, usize size_mb, usize thread_count);
+// Prints the TT fill rate, and the given TT usage counters when building with TT_STATS=yes
+void tt_show_stats(TranspositionTable *tt, const TtStats *stats);
+
+// Reallocates the TT as a small private table of the given size in KB, without clearing it. A size
+// of zero frees the table and leaves it NULL. Used for the per-worker qsearch caches
+void tt_resize_small(TranspositionTable *tt, usize size_kb);
+
+// Enum for the outcome of a TT file load
+typedef enum {
+    TtLoadMapped,
+    TtLoadCopied,
+    TtLoadIoError,
+    TtLoadBadFormat,
+    TtLoadSizeMismatch,
+} TtLoadStatus;
+
+// Writes the TT contents to the given file. The file is only replaced once the whole table has been
+// written, so it is safe to save over the file the table was loaded from. Returns false if the file
+// couldn't be written
+bool tt_dump_to_file(const TranspositionTable *tt, const char *filename);
+
+// Restores the TT contents from the given file, mapping it in memory when possible. Files saved
+// with a different TT size are rejected
+TtLoadStatus tt_load_from_file(TranspositionTable *tt, const char *filename, usize thread_count);
+
+// Reallocates the TT with the given size. If shared_name isn't NULL, the TT is attached to the
+// named shared memory segment so that it can be used by several processes at once. Otherwise (or
+// if attaching fails), the TT is backed by private memory, using huge pages depending on the large
+// pages policy
+void tt_resize(
+    TranspositionTable *tt,
+    usize size_mb,
+    usize thread_count,
+    LargePagesPolicy large_pages,
+    const char *shared_name
+);
 
 #endif
@@ -28,6 +28,11 @@
 typedef struct {
     i64 threads;
     i64 hash;
+    i64 qcache_size;
+    i64 eval_cache_size;
+    i64 king_pawn_hash;
+    i64 lazy_eval_margin;
+    i64 perft_hash;
     i64 move_overhead;
     i64 multi_pv;
     bool chess960;
@@ -35,13 +40,26 @@ typedef struct {
     bool show_wdl;
     bool normalize_score;
     bool tm_for_nodes;
+    bool numa_aware;
+    bool lazy_hash_clear;
+    bool use_nnue;
+    String large_pages;
+    String shared_hash;
+    String thread_binding;
+    String thread_cpu_list;
+    String eval_file;
 } OptionValues;
 
+struct BatchRun;
+
 typedef struct {
     OptionValues option_values;
     OptionList option_list;
     Board root_board;
     WorkerPool worker_pool;
+
+    // The batch analysis running in the background, if any
+    struct BatchRun *batch_run;
 } Uci;
 
 typedef struct {
@@ -52,18 +70,30 @@ typedef struct {
 void uci_init(Uci *uci);
 void uci_destroy(Uci *uci);
 
+// Makes the background batch analysis, if any, stop after the positions being analyzed
+void uci_stop_batch(Uci *uci);
+
+// Waits for the background batch analysis, if any, to finish, and releases its resources
+void uci_wait_batch(Uci *uci);
+
 // The list of supported commands by the engine
+void uci_batch(Uci *uci, StringView args);
 void uci_bench(Uci *uci, StringView args);
 void uci_d(Uci *uci, StringView args);
+void uci_datagen(Uci *uci, StringView args);
 void uci_debug(Uci *uci, StringView args);
 void uci_go(Uci *uci, StringView args);
 void uci_isready(Uci *uci, StringView args);
+void uci_loadhash(Uci *uci, StringView args);
 void uci_ponderhit(Uci *uci, StringView args);
 void uci_position(Uci *uci, StringView args);
 void uci_quit(Uci *uci, StringView args);
+void uci_savehash(Uci *uci, StringView args);
 void uci_setoption(Uci *uci, StringView args);
+void uci_speedtest(Uci *uci, StringView args);
 void uci_stop(Uci *uci, StringView args);
 void uci_t(Uci *uci, StringView args);
+void uci_ttstats(Uci *uci, StringView args);
 void uci_uci(Uci *uci, StringView args);
 void uci_ucinewgame(Uci *uci, StringView args);
 
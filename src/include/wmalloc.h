@@ -33,6 +33,32 @@
 
 #define wrap_aligned_free(ptr) wrap_aligned_free_internal(ptr, __BASE_FILE__, __LINE__)
 
+#define wrap_large_alloc(size, policy, page_kind) \
+    wrap_large_alloc_internal(size, policy, page_kind, __BASE_FILE__, __LINE__)
+
+#define wrap_large_free(ptr, size, page_kind) \
+    wrap_large_free_internal(ptr, size, page_kind, __BASE_FILE__, __LINE__)
+
+// Enum for the large page allocation strategies
+typedef enum {
+    LargePagesOff,
+    LargePagesTransparent,
+    LargePagesAuto,
+} LargePagesPolicy;
+
+// Enum for the type of pages backing a large allocation
+typedef enum {
+    PageKindDefault,
+    PageKindTransparent,
+    PageKindHuge2M,
+    PageKindHuge1G,
+    PageKindFileMapping,
+    PageKindShared,
+} PageKind;
+
+// Returns a human-readable description of the page kind
+const char *page_kind_name(PageKind page_kind);
+
 // Wrapper function for malloc() that will abort execution if the allocation fails. Don't use this
 // API section directly, use wrap_malloc() instead.
 void *wrap_malloc_internal(usize size, const char *source_file, usize line);
@@ -49,4 +75,32 @@ void *wrap_aligned_alloc_internal(usize alignment, usize size, const char *sourc
 // wrap_aligned_free() instead.
 void wrap_aligned_free_internal(void *ptr, const char *source_file, usize line);
 
+// Wrapper function for large, page-aligned allocations (typically the transposition table) that
+// tries to back the memory with huge pages according to the given policy, and reports the kind of
+// pages obtained. Aborts execution if the allocation fails. Don't use this API section directly, use
+// wrap_large_alloc() instead.
+void *wrap_large_alloc_internal(
+    usize size,
+    LargePagesPolicy policy,
+    PageKind *page_kind,
+    const char *source_file,
+    usize line
+);
+
+// Creates or attaches to the named shared memory segment of the given size, and sets created
+// accordingly. Segments created by other processes with a different size or layout tag are
+// rejected. Returns NULL on failure, or if shared memory isn't supported on this platform. The
+// memory must be freed with wrap_large_free() and the PageKindShared kind.
+void *shared_alloc(const char *name, usize size, u64 layout_tag, bool *created);
+
+// Wrapper function for freeing memory obtained through wrap_large_alloc(). Don't use this API
+// section directly, use wrap_large_free() instead.
+void wrap_large_free_internal(
+    void *ptr,
+    usize size,
+    PageKind page_kind,
+    const char *source_file,
+    usize line
+);
+
 #endif
@@ -23,9 +23,13 @@
 #include <stdatomic.h>
 
 #include "board.h"
+#include "eval_cache.h"
 #include "history.h"
 #include "kp_eval.h"
+#include "material.h"
+#include "perft.h"
 #include "search_params.h"
+#include "search_stats.h"
 #include "timeman.h"
 #include "tt.h"
 
@@ -65,6 +69,24 @@ RootMove *find_root_move(RootMove *root_moves, usize root_count, Move move);
 // Sorts root moves based on their score
 void sort_root_moves(RootMove *root_moves, usize root_count);
 
+#ifndef NODE_PUBLISH_INTERVAL
+// Number of nodes after which workers publish their node count to the other threads. Can be
+// overridden at build time, for comparing the scaling of both builds with `speedtest`.
+#define NODE_PUBLISH_INTERVAL 1024
+#endif
+
+// Enum for the tasks a worker thread can perform. Per-worker tables are allocated and cleared by
+// the worker thread itself, so that their pages get first touched from the thread using them.
+typedef enum {
+    WorkerTaskSearch,
+    WorkerTaskInitTables,
+    WorkerTaskResizeQcache,
+    WorkerTaskResizeEvalCache,
+    WorkerTaskResizeKingPawnTable,
+    WorkerTaskNewGame,
+    WorkerTaskExit,
+} WorkerTask;
+
 // Struct for worker thread data
 typedef struct {
     Board board;
@@ -77,23 +99,47 @@ typedef struct {
     CorrectionHistory *nonpawn_corrhist;
     CorrectionHistory *minor_corrhist;
     CorrectionHistory *major_corrhist;
-    KingPawnTable *king_pawn_table;
+    KingPawnTable king_pawn_table;
+    MaterialTable *material_table;
+    TranspositionTable qcache;
+    EvalCache eval_cache;
+
+    // Stack of NNUE accumulators, one per ply from the root
+    NnueAccumulator *nnue_accumulators;
 
     u16 seldepth;
     u16 root_depth;
+    u16 completed_depth;
+    Score completed_score;
+
+    // Time elapsed since the start of the search when each iteration got completed. Only the main
+    // worker keeps track of it.
+    Duration depth_times[MAX_PLIES + 1];
+
     i16 nmp_verif_plies;
-    _Atomic u64 nodes;
+    u64 nodes;
+#ifdef SEARCH_STATS
+    SearchStats search_stats;
+#endif
+#ifdef TT_STATS
+    TtStats tt_stats;
+#endif
 
     RootMove *root_moves;
     usize root_move_count;
     u16 pv_line;
 
     usize thread_index;
+    usize numa_node;
     pthread_t thread;
     pthread_mutex_t mutex;
     pthread_cond_t condvar;
-    bool must_exit;
-    bool is_searching;
+    WorkerTask task;
+    bool is_busy;
+
+    // Copy of the node count that other threads can read. It lives on its own cache line, so that
+    // reading it doesn't steal the lines the worker writes to at every node.
+    _Alignas(64) _Atomic u64 published_nodes;
 } Worker;
 
 // Returns the worker struct associated with the given board
@@ -109,63 +155,113 @@ INLINED void board_enable_worker(Board *board) {
 
 // Returns a pseudo-random draw score using the current node count
 INLINED Score worker_draw_score(const Worker *worker) {
-    return (Score)(atomic_load_explicit(&worker->nodes, memory_order_relaxed) & 2) - 1;
+    return (Score)(worker->nodes & 2) - 1;
+}
+
+// Makes the exact node count of the worker visible to the other threads
+INLINED void worker_publish_nodes(Worker *worker) {
+    atomic_store_explicit(&worker->published_nodes, worker->nodes, memory_order_relaxed);
 }
 
 INLINED void worker_increment_nodes(Worker *worker) {
-    atomic_fetch_add_explicit(&worker->nodes, 1, memory_order_relaxed);
+    ++worker->nodes;
+
+    if (worker->nodes % NODE_PUBLISH_INTERVAL == 0) {
+        worker_publish_nodes(worker);
+    }
 }
 
-// Initializes the worker
+// Initializes the worker, and starts its thread. The worker then allocates its tables on its own
 void worker_init(Worker *worker, usize thread_index, struct WorkerPool *wpool);
 
 // Frees all memory associated with the worker
 void worker_destroy(Worker *worker);
 
-// Resets the worker at the start of a new game
+// Resets the worker at the start of a new game. Should only be called from the worker thread
 void worker_init_new_game(Worker *worker);
 
-// Asks the worker to start searching
-void worker_start_searching(Worker *worker);
+// Asks the worker to perform the given task, after waiting for the completion of its current one
+void worker_start_task(Worker *worker, WorkerTask task);
 
 // Helper for the worker to set up its own search state
 void worker_init_search_data(Worker *worker);
 
-// Waits for the worker to complete its search
-void worker_wait_search_completion(Worker *worker);
+// Waits for the worker to complete its current task
+void worker_wait_task_completion(Worker *worker);
 
 // Entry point for the worker thread main loop
 void *worker_entry_point(void *worker_ptr);
 
+// Struct for a TT resize running in the background, so that the UCI thread isn't blocked while the
+// new table gets allocated and cleared. Once complete, the job keeps describing the last resize
+// until the next one starts.
+typedef struct {
+    pthread_t thread;
+    bool pending;
+    usize size_mb;
+    usize thread_count;
+    LargePagesPolicy large_pages;
+    char *shared_name;
+} TtResizeJob;
+
 typedef struct WorkerPool {
     pthread_attr_t worker_pthread_attr;
     usize worker_count;
+
+    // Index of the first worker of the pool among all workers of the process, used for placing
+    // threads when several pools run side by side
+    usize thread_offset;
     Worker **worker_list;
 
     Board root_board;
     SearchParams search_params;
     TranspositionTable tt;
+    TtResizeJob tt_resize;
     Timeman timeman;
 
     u64 check_nodes;
+    usize qcache_kb;
+    usize eval_cache_kb;
+    usize king_pawn_kb;
+
+    // Root moves are handed out to workers through this index during perft runs, and each worker
+    // writes the leaf count of its root moves in the array below.
+    PerftTable perft_table;
+    _Atomic usize perft_next_root;
+    u64 perft_counts[MAX_MOVES];
+
     atomic_bool ponder;
     atomic_bool stop;
+
+    // Used by the main thread to sleep until `stop` or `ponderhit` once its search is over
+    pthread_mutex_t release_mutex;
+    pthread_cond_t release_condvar;
 } WorkerPool;
 
-INLINED Worker *wpool_main_worker(WorkerPool *wpool) {
-    return wpool->worker_list[0];
+// Returns the table used by qsearch, which is the worker's qsearch cache if it has one, and the
+// main TT otherwise
+INLINED TranspositionTable *worker_qsearch_table(Worker *worker) {
+    return worker->qcache.table != NULL ? &worker->qcache : &worker->pool->tt;
 }
 
-INLINED void wpool_ponderhit(WorkerPool *wpool) {
-    atomic_store_explicit(&wpool->ponder, false, memory_order_relaxed);
+// Returns the worker's usage counters for the given table. Only the main TT is tracked, and only
+// when building with TT_STATS=yes
+INLINED TtStats *worker_tt_stats(Worker *worker, const TranspositionTable *tt) {
+#ifdef TT_STATS
+    return tt == &worker->pool->tt ? &worker->tt_stats : NULL;
+#else
+    (void)worker;
+    (void)tt;
+    return NULL;
+#endif
 }
 
-INLINED bool wpool_is_pondering(const WorkerPool *wpool) {
-    return atomic_load_explicit(&wpool->ponder, memory_order_relaxed);
+INLINED Worker *wpool_main_worker(WorkerPool *wpool) {
+    return wpool->worker_list[0];
 }
 
-INLINED void wpool_stop(WorkerPool *wpool) {
-    atomic_store_explicit(&wpool->stop, true, memory_order_relaxed);
+INLINED bool wpool_is_pondering(const WorkerPool *wpool) {
+    return atomic_load_explicit(&wpool->ponder, memory_order_relaxed);
 }
 
 INLINED bool wpool_is_stopped(const WorkerPool *wpool) {
@@ -174,10 +270,42 @@ INLINED bool wpool_is_stopped(const WorkerPool *wpool) {
 
 // These functions can be called from the UCI thread.
 
-void wpool_init(WorkerPool *wpool);
+// Initializes the worker pool with a single worker, and allocates its TT with the given size in MB
+// and clearing mode
+void wpool_init(WorkerPool *wpool, usize thread_offset, usize hash_mb, bool lazy_clear);
 void wpool_resize(WorkerPool *wpool, usize worker_count);
 void wpool_destroy(WorkerPool *wpool);
 void wpool_init_new_game(WorkerPool *wpool);
+
+// Resizes the per-worker qsearch caches. A size of zero disables them, in which case qsearch uses
+// the main TT.
+void wpool_set_qcache_size(WorkerPool *wpool, usize size_kb);
+
+// Resizes the per-worker eval caches, and clears them. A size of zero disables them. This must also
+// be called when the evaluation function changes, as the cached evals would be stale.
+void wpool_set_eval_cache_size(WorkerPool *wpool, usize size_kb);
+
+// Resizes the per-worker King-Pawn tables, and clears them
+void wpool_set_king_pawn_size(WorkerPool *wpool, usize size_kb);
+
+// Resizes the perft hash table. A size of zero disables it
+void wpool_set_perft_hash_size(WorkerPool *wpool, usize size_mb);
+
+// Starts resizing the TT in a background thread, see tt_resize() for the parameters. The TT must
+// not be accessed until wpool_wait_tt_resize() has been called; all pool functions using the TT do
+// this on their own.
+void wpool_resize_tt(
+    WorkerPool *wpool,
+    usize size_mb,
+    usize thread_count,
+    LargePagesPolicy large_pages,
+    const char *shared_name
+);
+
+// Waits for the background TT resize to complete. Returns true if a resize was pending, in which
+// case wpool->tt_resize still holds its parameters
+bool wpool_wait_tt_resize(WorkerPool *wpool);
+
 void wpool_start_search(
     WorkerPool *wpool,
     const Board *root_board,
@@ -187,13 +315,34 @@ void wpool_wait_search_completion(WorkerPool *wpool);
 
 // These functions can be called from the main thread.
 
+// Blocks until the search is stopped, or until the ponder search turns into a normal one when not
+// in infinite mode
+void wpool_wait_search_release(WorkerPool *wpool, bool infinite);
+
 void wpool_init_new_search(WorkerPool *wpool);
 void wpool_start_aux_workers(WorkerPool *wpool);
 void wpool_wait_aux_workers(WorkerPool *wpool);
 void wpool_check_time(WorkerPool *wpool);
 
+// Returns the number of nodes searched so far. The count of the main worker is exact, while the
+// counts of auxiliary workers lag behind by less than NODE_PUBLISH_INTERVAL nodes each as long as
+// they are searching. The total is exact once the search is complete, in which case this can also
+// be called from the UCI thread.
+u64 wpool_get_total_nodes(const WorkerPool *wpool);
+
 // These functions can be called from any thread.
 
-u64 wpool_get_total_nodes(const WorkerPool *wpool);
+void wpool_ponderhit(WorkerPool *wpool);
+void wpool_stop(WorkerPool *wpool);
+
+#ifdef SEARCH_STATS
+// Returns the search event counters of all workers during the last search
+void wpool_get_search_stats(const WorkerPool *wpool, SearchStats *stats);
+#endif
+
+#ifdef TT_STATS
+// Returns the TT usage counters of all workers during the last search
+void wpool_get_tt_stats(const WorkerPool *wpool, TtStats *stats);
+#endif
 
 #endif
@@ -0,0 +1,378 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "search.h"
+#include "syncio.h"
+#include "uci.h"
+#include "wmalloc.h"
+
+enum {
+    BATCH_DEFAULT_DEPTH = 10,
+    BATCH_DEFAULT_HASH = 16,
+};
+
+// Struct for a batch analysis thread. Each thread runs single-threaded searches with its own worker
+// pool, so that positions are analyzed independently of each other.
+typedef struct BatchThread {
+    pthread_t thread;
+    usize thread_index;
+    struct BatchRun *run;
+    WorkerPool pool;
+} BatchThread;
+
+// Struct for the state shared by all batch analysis threads. The run goes on in the background,
+// so that the UCI thread can still handle a stop command.
+typedef struct BatchRun {
+    FILE *input;
+    FILE *output;
+    pthread_mutex_t input_mutex;
+    pthread_mutex_t output_mutex;
+    String go_args;
+    usize hash_mb;
+    i64 move_overhead;
+    bool chess960;
+    bool normalize_score;
+    u64 position_count;
+    BatchThread *thread_list;
+    usize thread_count;
+    Timepoint start;
+    _Atomic bool stop;
+    _Atomic usize running_threads;
+} BatchRun;
+
+// Searches the given position, and appends the result line to the string. Returns false if the
+// position is invalid
+static bool batch_analyze(BatchThread *batch_thread, StringView fen, String *result) {
+    const BatchRun *run = batch_thread->run;
+    WorkerPool *wpool = &batch_thread->pool;
+    Boardstack *stack = wrap_malloc(sizeof(Boardstack));
+    Board board;
+    SearchParams search_params;
+
+    if (!board_try_init(&board, fen, run->chess960, stack)) {
+        boardstack_destroy(stack);
+        return false;
+    }
+
+    search_params_init(&search_params, run->move_overhead, 1, false, run->normalize_score, false);
+    search_params_set_from_uci(&search_params, &board, strview_from_string(&run->go_args));
+    search_params.silent = true;
+
+    // Start each search from clean tables, so that results don't depend on the order in which
+    // positions are analyzed. The TT is cleared lazily to keep this cheap.
+    wpool_init_new_game(wpool);
+    wpool_start_search(wpool, &board, &search_params);
+    wpool_wait_search_completion(wpool);
+
+    const Worker *worker = wpool_main_worker(wpool);
+    const bool has_moves = movelist_size(&search_params.searchmoves) != 0;
+
+    string_push_back_strview(result, board_get_fen(&board));
+    string_push_back_strview(result, STATIC_STRVIEW(" ; bestmove "));
+
+    if (has_moves) {
+        const RootMove *root_move = &worker->root_moves[0];
+
+        string_push_back_strview(result, board_move_to_uci(&board, root_move->move));
+        string_push_back_strview(result, STATIC_STRVIEW(" ; score "));
+        info_append_score(
+            result,
+            worker->completed_depth != 0 ? worker->completed_score : 0,
+            run->normalize_score
+        );
+        string_push_back_strview(result, STATIC_STRVIEW(" ; depth "));
+        string_push_back_u64(result, worker->completed_depth);
+        string_push_back_strview(result, STATIC_STRVIEW(" ; nodes "));
+        string_push_back_u64(result, wpool_get_total_nodes(wpool));
+        string_push_back_strview(result, STATIC_STRVIEW(" ; pv"));
+
+        for (usize i = 0; i < root_move->pv.length; ++i) {
+            string_push_back(result, ' ');
+            string_push_back_strview(result, board_move_to_uci(&board, root_move->pv.moves[i]));
+        }
+    } else {
+        string_push_back_strview(result, STATIC_STRVIEW("0000 ; score "));
+        string_push_back_strview(
+            result,
+            board.stack->checkers ? STATIC_STRVIEW("mate 0") : STATIC_STRVIEW("cp 0")
+        );
+        string_push_back_strview(result, STATIC_STRVIEW(" ; depth 0 ; nodes 0 ; pv"));
+    }
+
+    string_push_back(result, '\n');
+    boardstack_destroy(board.stack);
+    return true;
+}
+
+static void *batch_thread_entry_point(void *batch_thread_ptr) {
+    BatchThread *batch_thread = (BatchThread *)batch_thread_ptr;
+    BatchRun *run = batch_thread->run;
+    String line;
+    String result;
+
+    string_init(&line);
+    string_init(&result);
+
+    // Check for a stop request between positions, so that the results already written stay
+    // complete.
+    while (!atomic_load_explicit(&run->stop, memory_order_relaxed)) {
+        pthread_mutex_lock(&run->input_mutex);
+        const bool has_line = string_getline(run->input, &line) != 0;
+        pthread_mutex_unlock(&run->input_mutex);
+
+        if (!has_line) {
+            break;
+        }
+
+        const StringView trimmed = strview_trim_whitespaces(strview_from_string(&line));
+
+        // Skip blank lines and comments.
+        if (trimmed.size == 0 || trimmed.data[0] == '#') {
+            continue;
+        }
+
+        string_clear(&result);
+
+        if (!batch_analyze(batch_thread, board_fen_from_epd(trimmed), &result)) {
+            sync_lock_stdout();
+            printf(
+                "info string Skipping invalid position '%.*s'\n",
+                (int)trimmed.size,
+                (const char *)trimmed.data
+            );
+            fflush(stdout);
+            sync_unlock_stdout();
+            continue;
+        }
+
+        // Results are written as soon as they are available, so the output order may differ from
+        // the input order.
+        pthread_mutex_lock(&run->output_mutex);
+        fwrite_string(run->output, &result);
+        fflush(run->output);
+        ++run->position_count;
+        pthread_mutex_unlock(&run->output_mutex);
+    }
+
+    string_destroy(&line);
+    string_destroy(&result);
+
+    // The last thread to finish reports the run, since the UCI thread doesn't wait for it.
+    if (atomic_fetch_sub_explicit(&run->running_threads, 1, memory_order_acq_rel) == 1) {
+        pthread_mutex_lock(&run->output_mutex);
+        const u64 position_count = run->position_count;
+        pthread_mutex_unlock(&run->output_mutex);
+
+        sync_lock_stdout();
+        printf(
+            "info string Analyzed " FORMAT_LARGE_INT " positions in " FORMAT_LARGE_INT " ms%s\n",
+            (LargeInt)position_count,
+            (LargeInt)timepoint_diff(run->start, timepoint_now()),
+            atomic_load_explicit(&run->stop, memory_order_relaxed) ? " (stopped)" : ""
+        );
+        fflush(stdout);
+        sync_unlock_stdout();
+    }
+
+    return NULL;
+}
+
+// Opens the file named by the next word of the arguments
+static FILE *batch_open_file(StringView *args, const char *mode) {
+    const StringView word = strview_next_word(args);
+    String filename;
+    FILE *f;
+
+    if (word.size == 0) {
+        return NULL;
+    }
+
+    string_init_from_strview(&filename, word);
+    string_push_back(&filename, '\0');
+    f = fopen((const char *)filename.data, mode);
+
+    if (f == NULL) {
+        sync_lock_stdout();
+        printf("info string Unable to open '%s'\n", (const char *)filename.data);
+        fflush(stdout);
+        sync_unlock_stdout();
+    }
+
+    string_destroy(&filename);
+    return f;
+}
+
+void uci_batch(Uci *uci, StringView args) {
+    BatchRun *run;
+    u64 depth = 0;
+    u64 nodes = 0;
+    u64 thread_count = (u64)uci->option_values.threads;
+    u64 hash_mb = BATCH_DEFAULT_HASH;
+
+    wpool_wait_search_completion(&uci->worker_pool);
+
+    // Only one batch runs at a time.
+    uci_wait_batch(uci);
+
+    run = wrap_malloc(sizeof(BatchRun));
+    run->input = batch_open_file(&args, "r");
+    run->output = run->input != NULL ? batch_open_file(&args, "w") : NULL;
+
+    if (run->output == NULL) {
+        if (run->input != NULL) {
+            fclose(run->input);
+        }
+
+        sync_lock_stdout();
+        puts(
+            "info string Usage: batch <input> <output> [depth <d>] [nodes <n>] [threads <t>] "
+            "[hash <mb>]"
+        );
+        fflush(stdout);
+        sync_unlock_stdout();
+        free(run);
+        return;
+    }
+
+    while (true) {
+        const StringView token = strview_next_word(&args);
+        u64 value;
+
+        if (token.size == 0) {
+            break;
+        }
+
+        if (!strview_parse_u64(strview_next_word(&args), &value)) {
+            info_debug(
+                "info string Error: missing value for batch parameter '%.*s'\n",
+                (int)token.size,
+                (const char *)token.data
+            );
+            continue;
+        }
+
+        if (strview_equals_strview(token, STATIC_STRVIEW("depth"))) {
+            depth = u64_min(value, MAX_PLIES);
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("nodes"))) {
+            nodes = value;
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("threads"))) {
+            thread_count = u64_max(value, 1);
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("hash"))) {
+            hash_mb = u64_max(value, 1);
+        } else {
+            info_debug(
+                "info string Error: unknown batch parameter '%.*s'\n",
+                (int)token.size,
+                (const char *)token.data
+            );
+        }
+    }
+
+    // Fall back to a fixed depth if no search limit was given.
+    if (depth == 0 && nodes == 0) {
+        depth = BATCH_DEFAULT_DEPTH;
+    }
+
+    string_init(&run->go_args);
+
+    if (depth != 0) {
+        string_push_back_strview(&run->go_args, STATIC_STRVIEW("depth "));
+        string_push_back_u64(&run->go_args, depth);
+    }
+
+    if (nodes != 0) {
+        string_push_back_strview(&run->go_args, STATIC_STRVIEW(" nodes "));
+        string_push_back_u64(&run->go_args, nodes);
+    }
+
+    run->hash_mb = (usize)hash_mb;
+    run->move_overhead = uci->option_values.move_overhead;
+    run->chess960 = uci->option_values.chess960;
+    run->normalize_score = uci->option_values.normalize_score;
+    run->position_count = 0;
+
+    if (pthread_mutex_init(&run->input_mutex, NULL)
+        || pthread_mutex_init(&run->output_mutex, NULL)) {
+        perror("Unable to initialize batch locks");
+        exit(EXIT_FAILURE);
+    }
+
+    run->thread_list = wrap_malloc(sizeof(BatchThread) * thread_count);
+    run->thread_count = (usize)thread_count;
+    run->start = timepoint_now();
+    atomic_init(&run->stop, false);
+    atomic_init(&run->running_threads, run->thread_count);
+
+    for (usize i = 0; i < run->thread_count; ++i) {
+        BatchThread *batch_thread = &run->thread_list[i];
+
+        batch_thread->thread_index = i;
+        batch_thread->run = run;
+        wpool_init(&batch_thread->pool, i, run->hash_mb, true);
+
+        if (pthread_create(&batch_thread->thread, NULL, batch_thread_entry_point, batch_thread)) {
+            perror("Unable to create batch threads");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uci->batch_run = run;
+}
+
+void uci_stop_batch(Uci *uci) {
+    BatchRun *run = uci->batch_run;
+
+    if (run == NULL) {
+        return;
+    }
+
+    atomic_store_explicit(&run->stop, true, memory_order_relaxed);
+
+    // Also stop the searches in progress. Their results are still written, with the depth they
+    // completed.
+    for (usize i = 0; i < run->thread_count; ++i) {
+        wpool_stop(&run->thread_list[i].pool);
+    }
+}
+
+void uci_wait_batch(Uci *uci) {
+    BatchRun *run = uci->batch_run;
+
+    if (run == NULL) {
+        return;
+    }
+
+    for (usize i = 0; i < run->thread_count; ++i) {
+        pthread_join(run->thread_list[i].thread, NULL);
+        wpool_destroy(&run->thread_list[i].pool);
+    }
+
+    free(run->thread_list);
+    pthread_mutex_destroy(&run->input_mutex);
+    pthread_mutex_destroy(&run->output_mutex);
+    string_destroy(&run->go_args);
+    fclose(run->input);
+    fclose(run->output);
+    free(run);
+    uci->batch_run = NULL;
+}
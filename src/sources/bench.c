@@ -16,9 +16,15 @@
 **    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
+#include "nnue.h"
+#include "numa.h"
+#include "syncio.h"
 #include "uci.h"
+#include "wmalloc.h"
 
 // List of positions used during bench
 const StringView BenchFENs[] = {
@@ -75,48 +81,782 @@ const StringView BenchFENs[] = {
     STATIC_STRVIEW(""),
 };
 
+enum {
+    BENCH_DEFAULT_DEPTH = 13,
+    SPEEDTEST_DEFAULT_MOVETIME = 1000,
+};
+
+// Enum for the bench report formats
+typedef enum {
+    BenchFormatText,
+    BenchFormatCsv,
+    BenchFormatJson,
+} BenchFormat;
+
+// Struct for the statistics of a measure across bench runs
+typedef struct {
+    f64 median;
+    f64 mean;
+    f64 stddev;
+} BenchStats;
+
+static int compare_f64(const void *lhs, const void *rhs) {
+    const f64 l = *(const f64 *)lhs;
+    const f64 r = *(const f64 *)rhs;
+
+    return (l > r) - (l < r);
+}
+
+// Computes the median, mean and sample standard deviation of the values. The array gets sorted in
+// the process
+static BenchStats bench_stats_compute(f64 *values, usize count) {
+    BenchStats stats = {0.0, 0.0, 0.0};
+
+    qsort(values, count, sizeof(f64), compare_f64);
+    stats.median =
+        count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+
+    for (usize i = 0; i < count; ++i) {
+        stats.mean += values[i];
+    }
+
+    stats.mean /= (f64)count;
+
+    if (count > 1) {
+        for (usize i = 0; i < count; ++i) {
+            stats.stddev += (values[i] - stats.mean) * (values[i] - stats.mean);
+        }
+
+        stats.stddev = sqrt(stats.stddev / (f64)(count - 1));
+    }
+
+    return stats;
+}
+
+// Sets the given UCI option to a numeric value
+static void bench_set_option(Uci *uci, const char *name, i64 value) {
+    String option_args;
+
+    string_init_from_strview(&option_args, STATIC_STRVIEW("name "));
+    string_push_back_strview(&option_args, strview_from_cstr(name));
+    string_push_back_strview(&option_args, STATIC_STRVIEW(" value "));
+    string_push_back_i64(&option_args, value);
+    uci_setoption(uci, strview_from_string(&option_args));
+    string_destroy(&option_args);
+}
+
+// Starts searching the current position, like the 'go' command does. The search output can be
+// silenced so that it doesn't mix with the machine-readable reports.
+static void bench_go(Uci *uci, StringView go_args, bool silent) {
+    SearchParams search_params;
+
+    search_params_init(
+        &search_params,
+        uci->option_values.move_overhead,
+        uci->option_values.multi_pv,
+        uci->option_values.show_wdl,
+        uci->option_values.normalize_score,
+        uci->option_values.tm_for_nodes
+    );
+    search_params_set_from_uci(&search_params, &uci->root_board, go_args);
+    search_params.silent = silent;
+    wpool_start_search(&uci->worker_pool, &uci->root_board, &search_params);
+}
+
 void uci_bench(Uci *uci, StringView args) {
+    const i64 old_threads = uci->option_values.threads;
+    const i64 old_hash = uci->option_values.hash;
     u64 depth = 0;
+    u64 thread_count = (u64)old_threads;
+    u64 hash_mb = (u64)old_hash;
+    u64 repeat = 1;
+    bool use_nnue = uci->option_values.use_nnue;
+    BenchFormat format = BenchFormatText;
+
+    // The depth can be given as the first argument without a keyword, for compatibility with older
+    // bench scripts.
+    StringView first = args;
+
+    if (strview_parse_u64(strview_next_word(&first), &depth)) {
+        args = first;
+    }
+
+    while (true) {
+        const StringView token = strview_next_word(&args);
+        const StringView value_str = strview_next_word(&args);
+        u64 value = 0;
+
+        if (token.size == 0) {
+            break;
+        }
+
+        if (strview_equals_strview(token, STATIC_STRVIEW("format"))) {
+            if (strview_equals_strview(value_str, STATIC_STRVIEW("csv"))) {
+                format = BenchFormatCsv;
+            } else if (strview_equals_strview(value_str, STATIC_STRVIEW("json"))) {
+                format = BenchFormatJson;
+            } else if (strview_equals_strview(value_str, STATIC_STRVIEW("text"))) {
+                format = BenchFormatText;
+            } else {
+                info_debug(
+                    "info string Error: unknown bench format '%.*s'\n",
+                    (int)value_str.size,
+                    (const char *)value_str.data
+                );
+            }
+
+            continue;
+        }
+
+        if (strview_equals_strview(token, STATIC_STRVIEW("eval"))) {
+            if (strview_equals_strview(value_str, STATIC_STRVIEW("nnue"))) {
+                use_nnue = true;
+            } else if (strview_equals_strview(value_str, STATIC_STRVIEW("hce"))) {
+                use_nnue = false;
+            } else {
+                info_debug(
+                    "info string Error: unknown bench evaluation '%.*s'\n",
+                    (int)value_str.size,
+                    (const char *)value_str.data
+                );
+            }
+
+            continue;
+        }
+
+        if (!strview_parse_u64(value_str, &value)) {
+            info_debug(
+                "info string Error: missing value for bench parameter '%.*s'\n",
+                (int)token.size,
+                (const char *)token.data
+            );
+            continue;
+        }
+
+        if (strview_equals_strview(token, STATIC_STRVIEW("depth"))) {
+            depth = value;
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("threads"))) {
+            thread_count = value;
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("hash"))) {
+            hash_mb = value;
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("repeat"))) {
+            repeat = u64_max(value, 1);
+        } else {
+            info_debug(
+                "info string Error: unknown bench parameter '%.*s'\n",
+                (int)token.size,
+                (const char *)token.data
+            );
+        }
+    }
+
+    // If bench depth is absent or invalid, use the default depth.
+    if (depth == 0 || depth > MAX_PLIES) {
+        depth = BENCH_DEFAULT_DEPTH;
+    }
+
+    wpool_wait_search_completion(&uci->worker_pool);
+
+    if ((i64)thread_count != old_threads) {
+        bench_set_option(uci, "Threads", (i64)thread_count);
+    }
+
+    if ((i64)hash_mb != old_hash) {
+        bench_set_option(uci, "Hash", (i64)hash_mb);
+    }
+
+    // The evaluation is switched without going through the UseNNUE option, so that the option
+    // keeps its value once the bench is over.
+    nnue_set_enabled(use_nnue);
+
+    if (use_nnue && !nnue_is_active()) {
+        info_debug("info string Error: no network loaded, benching the classical evaluation\n");
+    }
+
+    const char *eval_name = nnue_is_active() ? "nnue" : "hce";
+    const bool silent = format != BenchFormatText;
 
-    // If bench depth is absent or invalid, use a default depth of 13.
-    if (!strview_parse_u64(strview_trim_whitespaces(args), &depth) || depth == 0
-        || depth > MAX_PLIES) {
-        depth = 13;
+    // Complete the hash table allocation now, so that its report doesn't mix with the
+    // machine-readable output.
+    if (silent) {
+        wpool_wait_tt_resize(&uci->worker_pool);
+    }
+
+    usize position_count = 0;
+
+    while (BenchFENs[position_count].size != 0) {
+        ++position_count;
     }
 
     String position_args;
     String go_args;
+    Duration *times = wrap_malloc(sizeof(Duration) * position_count * repeat);
+    u64 *nodes = wrap_malloc(sizeof(u64) * position_count * repeat);
+    f64 *values = wrap_malloc(sizeof(f64) * repeat);
+
+#ifdef SEARCH_STATS
+    SearchStats bench_search_stats;
+
+    search_stats_reset(&bench_search_stats);
+#endif
 
     string_init(&position_args);
     string_init_from_strview(&go_args, STATIC_STRVIEW("depth "));
     string_push_back_u64(&go_args, depth);
 
-    Duration bench_time = 0;
-    u64 total_nodes = 0;
+    for (usize run = 0; run < repeat; ++run) {
+        for (usize i = 0; i < position_count; ++i) {
+            string_clear(&position_args);
+            string_push_back_strview(&position_args, STATIC_STRVIEW("fen "));
+            string_push_back_strview(&position_args, BenchFENs[i]);
 
-    for (usize i = 0; BenchFENs[i].size != 0; ++i) {
-        string_clear(&position_args);
-        string_push_back_strview(&position_args, STATIC_STRVIEW("fen "));
-        string_push_back_strview(&position_args, BenchFENs[i]);
+            uci_ucinewgame(uci, EmptyStrview);
+            uci_position(uci, strview_from_string(&position_args));
 
-        uci_ucinewgame(uci, EmptyStrview);
-        uci_position(uci, strview_from_string(&position_args));
+            const Timepoint search_start = timepoint_now();
 
-        const Timepoint search_start = timepoint_now();
+            bench_go(uci, strview_from_string(&go_args), silent);
+            wpool_wait_search_completion(&uci->worker_pool);
 
-        uci_go(uci, strview_from_string(&go_args));
-        wpool_wait_search_completion(&uci->worker_pool);
+            times[run * position_count + i] = timepoint_diff(search_start, timepoint_now());
+            nodes[run * position_count + i] = wpool_get_total_nodes(&uci->worker_pool);
 
-        bench_time += timepoint_diff(search_start, timepoint_now());
-        total_nodes += wpool_get_total_nodes(&uci->worker_pool);
+#ifdef SEARCH_STATS
+            SearchStats search_stats;
+
+            wpool_get_search_stats(&uci->worker_pool, &search_stats);
+            search_stats_add(&bench_search_stats, &search_stats);
+#endif
+        }
     }
 
     string_destroy(&position_args);
     string_destroy(&go_args);
 
-    printf("Benchmark report:\n");
-    printf("TIME:  " FORMAT_LARGE_INT " milliseconds\n", (LargeInt)bench_time);
-    printf("NODES: " FORMAT_LARGE_INT "\n", (LargeInt)total_nodes);
-    printf("NPS:   " FORMAT_LARGE_INT "\n", (LargeInt)compute_nps(total_nodes, bench_time));
+    // Sum up the results of each run, and compute their statistics.
+    Duration *run_times = wrap_malloc(sizeof(Duration) * repeat);
+    u64 *run_nodes = wrap_malloc(sizeof(u64) * repeat);
+
+    for (usize run = 0; run < repeat; ++run) {
+        run_times[run] = 0;
+        run_nodes[run] = 0;
+
+        for (usize i = 0; i < position_count; ++i) {
+            run_times[run] += times[run * position_count + i];
+            run_nodes[run] += nodes[run * position_count + i];
+        }
+    }
+
+    for (usize run = 0; run < repeat; ++run) {
+        values[run] = (f64)run_times[run];
+    }
+
+    const BenchStats time_stats = bench_stats_compute(values, repeat);
+
+    for (usize run = 0; run < repeat; ++run) {
+        values[run] = (f64)run_nodes[run];
+    }
+
+    const BenchStats node_stats = bench_stats_compute(values, repeat);
+
+    for (usize run = 0; run < repeat; ++run) {
+        values[run] = (f64)compute_nps(run_nodes[run], run_times[run]);
+    }
+
+    const BenchStats nps_stats = bench_stats_compute(values, repeat);
+    const char *qsearch_table = uci->worker_pool.qcache_kb ? "qsearch cache" : "main TT";
+
+#ifdef SEARCH_STATS
+    const u64 qsearch_probes = bench_search_stats.qsearch_tt_probes;
+    const u64 qhits_permil =
+        qsearch_probes ? bench_search_stats.qsearch_tt_hits * 1000 / qsearch_probes : 0;
+    const u64 eval_cache_probes = bench_search_stats.eval_cache_probes;
+    const u64 king_pawn_probes = bench_search_stats.king_pawn_probes;
+    const u64 ehits_permil =
+        eval_cache_probes ? bench_search_stats.eval_cache_hits * 1000 / eval_cache_probes : 0;
+    const u64 khits_permil =
+        king_pawn_probes ? bench_search_stats.king_pawn_hits * 1000 / king_pawn_probes : 0;
+#endif
+
+    if (format == BenchFormatText) {
+        // The first run is reported as-is when there is a single one, and the medians are reported
+        // otherwise. The first NODES line always holds the node count of the first run, as some
+        // bench scripts rely on it.
+        const Duration bench_time = repeat == 1 ? run_times[0] : (Duration)time_stats.median;
+        const u64 bench_nps =
+            repeat == 1 ? compute_nps(run_nodes[0], run_times[0]) : (u64)nps_stats.median;
+
+        printf("Benchmark report:\n");
+        printf("TIME:  " FORMAT_LARGE_INT " milliseconds\n", (LargeInt)bench_time);
+        printf("NODES: " FORMAT_LARGE_INT "\n", (LargeInt)run_nodes[0]);
+        printf("NPS:   " FORMAT_LARGE_INT "\n", (LargeInt)bench_nps);
+        printf("EVAL:  %s\n", eval_name);
+        printf("PAGES: %s\n", page_kind_name(uci->worker_pool.tt.page_kind));
+#ifdef SEARCH_STATS
+        printf(
+            "QHITS: " FORMAT_LARGE_INT " permil of " FORMAT_LARGE_INT " qsearch probes (%s)\n",
+            (LargeInt)qhits_permil,
+            (LargeInt)qsearch_probes,
+            qsearch_table
+        );
+        printf(
+            "EHITS: " FORMAT_LARGE_INT " permil of " FORMAT_LARGE_INT " eval cache probes\n",
+            (LargeInt)ehits_permil,
+            (LargeInt)eval_cache_probes
+        );
+        printf(
+            "KHITS: " FORMAT_LARGE_INT " permil of " FORMAT_LARGE_INT
+            " King-Pawn table probes (" FORMAT_LARGE_INT " KB)\n",
+            (LargeInt)khits_permil,
+            (LargeInt)king_pawn_probes,
+            (LargeInt)uci->worker_pool.king_pawn_kb
+        );
+#endif
+
+        if (repeat > 1) {
+            printf("RUNS:  " FORMAT_LARGE_INT "\n", (LargeInt)repeat);
+            printf(
+                "TIME STATS:  median %.1lf, mean %.1lf, stddev %.1lf milliseconds\n",
+                time_stats.median,
+                time_stats.mean,
+                time_stats.stddev
+            );
+            printf(
+                "NODES STATS: median %.1lf, mean %.1lf, stddev %.1lf\n",
+                node_stats.median,
+                node_stats.mean,
+                node_stats.stddev
+            );
+            printf(
+                "NPS STATS:   median %.1lf, mean %.1lf, stddev %.1lf\n",
+                nps_stats.median,
+                nps_stats.mean,
+                nps_stats.stddev
+            );
+        }
+
+        printf("Per-position report (averaged over runs):\n");
+
+        for (usize i = 0; i < position_count; ++i) {
+            Duration time = 0;
+            u64 node_count = 0;
+
+            for (usize run = 0; run < repeat; ++run) {
+                time += times[run * position_count + i];
+                node_count += nodes[run * position_count + i];
+            }
+
+            time /= (Duration)repeat;
+            node_count /= repeat;
+            printf(
+                "Position %2u: %6" PRIi64 " ms %10" PRIu64 " nodes %10" PRIu64 " nps\n",
+                (unsigned int)i + 1,
+                (i64)time,
+                node_count,
+                compute_nps(node_count, time)
+            );
+        }
+
+#ifdef SEARCH_STATS
+        printf("Search stats (summed over all runs):\n");
+        fflush(stdout);
+        search_stats_show(&bench_search_stats);
+#endif
+    } else if (format == BenchFormatCsv) {
+        printf("kind,run,position,time_ms,nodes,nps\n");
+
+        for (usize run = 0; run < repeat; ++run) {
+            for (usize i = 0; i < position_count; ++i) {
+                const Duration time = times[run * position_count + i];
+                const u64 node_count = nodes[run * position_count + i];
+
+                printf(
+                    "position,%u,%u,%" PRIi64 ",%" PRIu64 ",%" PRIu64 "\n",
+                    (unsigned int)run + 1,
+                    (unsigned int)i + 1,
+                    (i64)time,
+                    node_count,
+                    compute_nps(node_count, time)
+                );
+            }
+
+            printf(
+                "total,%u,,%" PRIi64 ",%" PRIu64 ",%" PRIu64 "\n",
+                (unsigned int)run + 1,
+                (i64)run_times[run],
+                run_nodes[run],
+                compute_nps(run_nodes[run], run_times[run])
+            );
+        }
+
+        printf(
+            "median,,,%.1lf,%.1lf,%.1lf\n",
+            time_stats.median,
+            node_stats.median,
+            nps_stats.median
+        );
+        printf("mean,,,%.1lf,%.1lf,%.1lf\n", time_stats.mean, node_stats.mean, nps_stats.mean);
+        printf(
+            "stddev,,,%.1lf,%.1lf,%.1lf\n",
+            time_stats.stddev,
+            node_stats.stddev,
+            nps_stats.stddev
+        );
+    } else {
+        printf("{\n");
+        printf(
+            "  \"depth\": %" PRIu64 ",\n  \"threads\": %" PRIi64 ",\n  \"hash\": %" PRIi64
+            ",\n  \"runs\": %" PRIu64 ",\n",
+            depth,
+            uci->option_values.threads,
+            uci->option_values.hash,
+            repeat
+        );
+        printf(
+            "  \"eval\": \"%s\",\n  \"pages\": \"%s\",\n  \"qsearch_table\": \"%s\",\n"
+            "  \"king_pawn_kb\": %" PRIu64 ",\n",
+            eval_name,
+            page_kind_name(uci->worker_pool.tt.page_kind),
+            qsearch_table,
+            (u64)uci->worker_pool.king_pawn_kb
+        );
+#ifdef SEARCH_STATS
+        printf(
+            "  \"qsearch_probes\": %" PRIu64 ",\n  \"qsearch_hits_permil\": %" PRIu64 ",\n"
+            "  \"eval_cache_probes\": %" PRIu64 ",\n  \"eval_cache_hits_permil\": %" PRIu64 ",\n"
+            "  \"king_pawn_probes\": %" PRIu64 ",\n  \"king_pawn_hits_permil\": %" PRIu64 ",\n",
+            qsearch_probes,
+            qhits_permil,
+            eval_cache_probes,
+            ehits_permil,
+            king_pawn_probes,
+            khits_permil
+        );
+#endif
+        printf("  \"positions\": [\n");
+
+        for (usize i = 0; i < position_count; ++i) {
+            printf(
+                "    {\"fen\": \"%.*s\", \"time_ms\": [",
+                (int)BenchFENs[i].size,
+                (const char *)BenchFENs[i].data
+            );
+
+            for (usize run = 0; run < repeat; ++run) {
+                printf("%s%" PRIi64, run ? ", " : "", (i64)times[run * position_count + i]);
+            }
+
+            printf("], \"nodes\": [");
+
+            for (usize run = 0; run < repeat; ++run) {
+                printf("%s%" PRIu64, run ? ", " : "", nodes[run * position_count + i]);
+            }
+
+            printf("]}%s\n", i + 1 < position_count ? "," : "");
+        }
+
+        printf("  ],\n  \"totals\": [\n");
+
+        for (usize run = 0; run < repeat; ++run) {
+            printf(
+                "    {\"time_ms\": %" PRIi64 ", \"nodes\": %" PRIu64 ", \"nps\": %" PRIu64 "}%s\n",
+                (i64)run_times[run],
+                run_nodes[run],
+                compute_nps(run_nodes[run], run_times[run]),
+                run + 1 < repeat ? "," : ""
+            );
+        }
+
+        printf("  ],\n  \"summary\": {\n");
+        printf(
+            "    \"time_ms\": {\"median\": %.1lf, \"mean\": %.1lf, \"stddev\": %.1lf},\n",
+            time_stats.median,
+            time_stats.mean,
+            time_stats.stddev
+        );
+        printf(
+            "    \"nodes\": {\"median\": %.1lf, \"mean\": %.1lf, \"stddev\": %.1lf},\n",
+            node_stats.median,
+            node_stats.mean,
+            node_stats.stddev
+        );
+        printf(
+            "    \"nps\": {\"median\": %.1lf, \"mean\": %.1lf, \"stddev\": %.1lf}\n",
+            nps_stats.median,
+            nps_stats.mean,
+            nps_stats.stddev
+        );
+        printf("  }\n}\n");
+    }
+
     fflush(stdout);
+    free(times);
+    free(nodes);
+    free(values);
+    free(run_times);
+    free(run_nodes);
+
+    // Restore the engine settings that were overridden for the bench.
+    if (uci->option_values.threads != old_threads) {
+        bench_set_option(uci, "Threads", old_threads);
+    }
+
+    if (uci->option_values.hash != old_hash) {
+        bench_set_option(uci, "Hash", old_hash);
+    }
+
+    nnue_set_enabled(uci->option_values.use_nnue);
+
+    // Flush the evals computed with the other evaluation.
+    if (use_nnue != uci->option_values.use_nnue) {
+        uci_ucinewgame(uci, EmptyStrview);
+    }
+}
+
+// Struct for the measures of a speedtest run with a given thread count
+typedef struct {
+    u64 thread_count;
+    Duration time;
+    u64 nodes;
+    u64 depth_sum;
+    Duration ttd;
+    Duration reference_ttd;
+    usize ttd_reached;
+} SpeedtestRun;
+
+// Loads the positions of the given EPD file. Returns the number of positions loaded
+static usize speedtest_load_positions(String **positions, StringView filename_view) {
+    String filename;
+    String line;
+    usize count = 0;
+    usize capacity = 0;
+
+    string_init_from_strview(&filename, filename_view);
+    string_push_back(&filename, '\0');
+
+    FILE *f = fopen((const char *)filename.data, "r");
+
+    if (f == NULL) {
+        sync_lock_stdout();
+        printf("info string Unable to open '%s'\n", (const char *)filename.data);
+        fflush(stdout);
+        sync_unlock_stdout();
+        string_destroy(&filename);
+        return 0;
+    }
+
+    string_init(&line);
+
+    while (string_getline(f, &line) != 0) {
+        const StringView trimmed = strview_trim_whitespaces(strview_from_string(&line));
+
+        // Skip blank lines and comments.
+        if (trimmed.size == 0 || trimmed.data[0] == '#') {
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity += !capacity ? 16 : capacity / 2;
+            *positions = wrap_realloc(*positions, sizeof(String) * capacity);
+        }
+
+        string_init_from_strview(&(*positions)[count++], board_fen_from_epd(trimmed));
+    }
+
+    string_destroy(&line);
+    string_destroy(&filename);
+    fclose(f);
+    return count;
+}
+
+void uci_speedtest(Uci *uci, StringView args) {
+    const i64 old_threads = uci->option_values.threads;
+    u64 max_threads = u64_max((u64)old_threads, (u64)numa_cpu_count());
+    u64 movetime = SPEEDTEST_DEFAULT_MOVETIME;
+    String *positions = NULL;
+    usize position_count = 0;
+    bool from_file = false;
+
+    while (true) {
+        const StringView token = strview_next_word(&args);
+        const StringView value_str = strview_next_word(&args);
+        u64 value = 0;
+
+        if (token.size == 0) {
+            break;
+        }
+
+        if (strview_equals_strview(token, STATIC_STRVIEW("file"))) {
+            position_count = speedtest_load_positions(&positions, value_str);
+            from_file = true;
+
+            if (position_count == 0) {
+                free(positions);
+                return;
+            }
+
+            continue;
+        }
+
+        if (!strview_parse_u64(value_str, &value)) {
+            info_debug(
+                "info string Error: missing value for speedtest parameter '%.*s'\n",
+                (int)token.size,
+                (const char *)token.data
+            );
+            continue;
+        }
+
+        if (strview_equals_strview(token, STATIC_STRVIEW("threads"))) {
+            max_threads = u64_max(value, 1);
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("movetime"))) {
+            movetime = u64_max(value, 1);
+        } else {
+            info_debug(
+                "info string Error: unknown speedtest parameter '%.*s'\n",
+                (int)token.size,
+                (const char *)token.data
+            );
+        }
+    }
+
+    if (!from_file) {
+        while (BenchFENs[position_count].size != 0) {
+            ++position_count;
+        }
+
+        positions = wrap_malloc(sizeof(String) * position_count);
+
+        for (usize i = 0; i < position_count; ++i) {
+            string_init_from_strview(&positions[i], BenchFENs[i]);
+        }
+    }
+
+    // Test all powers of two below the maximal thread count, and the maximal thread count itself.
+    usize run_count = 0;
+    SpeedtestRun runs[64];
+
+    for (u64 threads = 1; threads < max_threads && run_count < 63; threads *= 2) {
+        runs[run_count++].thread_count = threads;
+    }
+
+    runs[run_count++].thread_count = max_threads;
+
+    // Time-to-depth is measured against the depths reached with the first thread count.
+    u16 *reference_depths = wrap_malloc(sizeof(u16) * position_count);
+    Duration *reference_times = wrap_malloc(sizeof(Duration) * position_count);
+    String position_args;
+    String go_args;
+
+    string_init(&position_args);
+    string_init_from_strview(&go_args, STATIC_STRVIEW("movetime "));
+    string_push_back_u64(&go_args, movetime);
+
+    wpool_wait_search_completion(&uci->worker_pool);
+
+    for (usize r = 0; r < run_count; ++r) {
+        SpeedtestRun *run = &runs[r];
+
+        run->time = 0;
+        run->nodes = 0;
+        run->depth_sum = 0;
+        run->ttd = 0;
+        run->reference_ttd = 0;
+        run->ttd_reached = 0;
+
+        if (uci->option_values.threads != (i64)run->thread_count) {
+            bench_set_option(uci, "Threads", (i64)run->thread_count);
+        }
+
+        sync_lock_stdout();
+        printf(
+            "info string Running speedtest with " FORMAT_LARGE_INT " threads\n",
+            (LargeInt)run->thread_count
+        );
+        fflush(stdout);
+        sync_unlock_stdout();
+
+        for (usize i = 0; i < position_count; ++i) {
+            string_clear(&position_args);
+            string_push_back_strview(&position_args, STATIC_STRVIEW("fen "));
+            string_push_back_strview(&position_args, strview_from_string(&positions[i]));
+
+            uci_ucinewgame(uci, EmptyStrview);
+            uci_position(uci, strview_from_string(&position_args));
+
+            const Timepoint search_start = timepoint_now();
+
+            bench_go(uci, strview_from_string(&go_args), true);
+            wpool_wait_search_completion(&uci->worker_pool);
+
+            const Worker *main_worker = wpool_main_worker(&uci->worker_pool);
+
+            run->time += timepoint_diff(search_start, timepoint_now());
+            run->nodes += wpool_get_total_nodes(&uci->worker_pool);
+            run->depth_sum += main_worker->completed_depth;
+
+            if (r == 0) {
+                reference_depths[i] = main_worker->completed_depth;
+                reference_times[i] = main_worker->completed_depth != 0
+                                         ? main_worker->depth_times[main_worker->completed_depth]
+                                         : 0;
+            }
+
+            if (reference_depths[i] != 0 && main_worker->completed_depth >= reference_depths[i]) {
+                run->ttd += main_worker->depth_times[reference_depths[i]];
+                run->reference_ttd += reference_times[i];
+                ++run->ttd_reached;
+            }
+        }
+    }
+
+    usize reference_count = 0;
+
+    for (usize i = 0; i < position_count; ++i) {
+        reference_count += reference_depths[i] != 0;
+    }
+
+    sync_lock_stdout();
+    printf(
+        "Speedtest report (" FORMAT_LARGE_INT " positions, movetime " FORMAT_LARGE_INT " ms):\n",
+        (LargeInt)position_count,
+        (LargeInt)movetime
+    );
+    printf("THREADS        NPS NPS/THREAD  AVG DEPTH   TTD (ms) TTD SPEEDUP  TTD REACHED\n");
+
+    for (usize r = 0; r < run_count; ++r) {
+        const SpeedtestRun *run = &runs[r];
+        const u64 nps = compute_nps(run->nodes, run->time);
+
+        // The speedup only accounts for the positions where the reference depth got reached, so
+        // that it isn't biased by the positions where it wasn't.
+        printf(
+            "%7" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10.2lf %10" PRIi64 " %11.2lf %6u/%u\n",
+            run->thread_count,
+            nps,
+            nps / run->thread_count,
+            (f64)run->depth_sum / (f64)position_count,
+            (i64)run->ttd,
+            (f64)run->reference_ttd / (f64)i64_max(run->ttd, 1),
+            (unsigned int)run->ttd_reached,
+            (unsigned int)reference_count
+        );
+    }
+
+    fflush(stdout);
+    sync_unlock_stdout();
+
+    for (usize i = 0; i < position_count; ++i) {
+        string_destroy(&positions[i]);
+    }
+
+    free(positions);
+    free(reference_depths);
+    free(reference_times);
+    string_destroy(&position_args);
+    string_destroy(&go_args);
+
+    if (uci->option_values.threads != old_threads) {
+        bench_set_option(uci, "Threads", old_threads);
+    }
 }
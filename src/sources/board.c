@@ -222,6 +222,10 @@ static void board_put_piece(Board *board, Piece piece, Square square) {
     ++board->piece_count[piece];
     ++board->piece_count[create_piece(piece_color(piece), ALL_PIECES)];
     board->psq_scorepair += psq_table(piece, square);
+
+    if (board->accumulator != NULL) {
+        nnue_accumulator_add(board->accumulator, piece, square);
+    }
 }
 
 // Helper function for moving pieces on the board
@@ -239,6 +243,10 @@ static void board_move_piece(Board *board, Square from, Square to) {
     board->piecetype_bb[piece_type(piece)] ^= move_bb;
     board->color_bb[piece_color(piece)] ^= move_bb;
     board->psq_scorepair += psq_table(piece, to) - psq_table(piece, from);
+
+    if (board->accumulator != NULL) {
+        nnue_accumulator_move(board->accumulator, piece, from, to);
+    }
 }
 
 // Helper function for taking pieces off the board
@@ -256,6 +264,10 @@ static void board_remove_piece(Board *board, Square square) {
     --board->piece_count[piece];
     --board->piece_count[create_piece(piece_color(piece), ALL_PIECES)];
     board->psq_scorepair -= psq_table(piece, square);
+
+    if (board->accumulator != NULL) {
+        nnue_accumulator_remove(board->accumulator, piece, square);
+    }
 }
 
 static Bitboard board_attackers_list(const Board *board, Square square, Bitboard occupancy) {
@@ -668,9 +680,31 @@ bool board_try_init(Board *board, StringView fen, bool is_chess960, Boardstack *
     return true;
 }
 
+StringView board_fen_from_epd(StringView line) {
+    StringView rest = line;
+
+    for (usize i = 0; i < 4; ++i) {
+        strview_next_word(&rest);
+    }
+
+    for (usize i = 0; i < 2; ++i) {
+        StringView next = rest;
+        u64 value;
+
+        if (!strview_parse_u64(strview_next_word(&next), &value)) {
+            break;
+        }
+
+        rest = next;
+    }
+
+    return strview_subview(line, 0, line.size - rest.size);
+}
+
 void board_clone(Board *restrict board, const Board *restrict other) {
     *board = *other;
     board->has_worker = false;
+    board->accumulator = NULL;
     board->stack = boardstack_clone(other->stack);
 }
 
@@ -1021,8 +1055,18 @@ void board_do_move_gc(
         move_type(move) == EN_PASSANT ? create_piece(them, PAWN) : board_piece_on(board, to);
     Key key = board->stack->board_key ^ ZobristSideToMove;
 
+#ifndef NDEBUG
+    const Key expected_key = board_key_after(board, move);
+#endif
+
     assert(piece_type(captured_piece) != KING);
 
+    // Push a copy of the accumulator, which then gets updated along with the pieces.
+    if (board->accumulator != NULL) {
+        board->accumulator[1] = board->accumulator[0];
+        ++board->accumulator;
+    }
+
     // Copy the state variables that will need to be updated incrementally. Don't copy things like
     // the checking squares, since they need to be computed from scratch after each move.
     new_stack->castlings = board->stack->castlings;
@@ -1149,6 +1193,7 @@ void board_do_move_gc(
 
     new_stack->captured_piece = captured_piece;
     new_stack->board_key = key;
+    assert(key == expected_key);
 
     // Save the list of checking pieces if the move gives check.
     new_stack->checkers = gives_check
@@ -1182,6 +1227,53 @@ void board_do_move_gc(
     board->stack = new_stack;
 }
 
+Key board_key_after(const Board *board, Move move) {
+    const Color us = board->side_to_move;
+    const Color them = color_flip(board->side_to_move);
+    const Square from = move_from(move);
+    Square to = move_to(move);
+    const Piece piece = board_piece_on(board, from);
+    const CastlingMask lost_castlings = board->castling_mask[from] | board->castling_mask[to];
+    Key key = board->stack->board_key ^ ZobristSideToMove;
+
+    // This mirrors the key updates of board_do_move_gc(), without touching the board.
+    if (move_type(move) == CASTLING) {
+        const bool kingside = to > from;
+        const Piece rook = create_piece(us, ROOK);
+
+        key ^= ZobristPsq[rook][to] ^ ZobristPsq[rook][square_relative(kingside ? SQ_F1 : SQ_D1, us)];
+        to = square_relative(kingside ? SQ_G1 : SQ_C1, us);
+    } else if (move_type(move) == EN_PASSANT) {
+        const Piece captured_pawn = create_piece(them, PAWN);
+        const Square capture_square = to - pawn_direction(us);
+
+        key ^= ZobristPsq[captured_pawn][capture_square];
+    } else if (!board_square_is_empty(board, to)) {
+        key ^= ZobristPsq[board_piece_on(board, to)][to];
+    }
+
+    key ^= ZobristPsq[piece][from] ^ ZobristPsq[piece][to];
+
+    if (board->stack->ep_square != SQ_NONE) {
+        key ^= ZobristEnPassant[square_file(board->stack->ep_square)];
+    }
+
+    if (board->stack->castlings & lost_castlings) {
+        key ^= ZobristCastling[board->stack->castlings & lost_castlings];
+    }
+
+    if (piece_type(piece) == PAWN) {
+        if ((to ^ from) == 16
+            && (pawn_attacks_bb(to - pawn_direction(us), us) & board_piece_bb(board, them, PAWN))) {
+            key ^= ZobristEnPassant[square_file(to)];
+        } else if (move_type(move) == PROMOTION) {
+            key ^= ZobristPsq[piece][to] ^ ZobristPsq[create_piece(us, move_promotion_type(move))][to];
+        }
+    }
+
+    return key;
+}
+
 void board_do_null_move(Board *restrict board, Boardstack *restrict new_stack) {
     // Copy the whole stack state. (NOTE: this part might be further optimized by only copying the
     // required fields as in the do_move_gc() function, this has not been tested yet.)
@@ -1237,9 +1329,14 @@ void board_undo_move(Board *board, Move move) {
     const Color us = color_flip(board->side_to_move);
     const Square from = move_from(move);
     Square to = move_to(move);
+    NnueAccumulator *const accumulator = board->accumulator;
 
     board->side_to_move = us;
 
+    // The previous accumulator is still intact, so pop back to it instead of reverting the piece
+    // updates.
+    board->accumulator = NULL;
+
     // If the move was a promotion, place the Pawn back.
     if (move_type(move) == PROMOTION) {
         board_remove_piece(board, to);
@@ -1267,6 +1364,10 @@ void board_undo_move(Board *board, Move move) {
     // Unlink the last stack, and decrement the ply counter.
     board->stack = board->stack->previous;
     board->ply -= 1;
+
+    if (accumulator != NULL) {
+        board->accumulator = accumulator - 1;
+    }
 }
 
 void board_undo_null_move(Board *board) {
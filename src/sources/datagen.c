@@ -0,0 +1,483 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "movelist.h"
+#include "random.h"
+#include "search.h"
+#include "syncio.h"
+#include "uci.h"
+#include "wmalloc.h"
+
+enum {
+    DATAGEN_DEFAULT_GAMES = 100,
+    DATAGEN_DEFAULT_NODES = 5000,
+    DATAGEN_DEFAULT_RANDOM_PLIES = 8,
+    DATAGEN_DEFAULT_HASH = 16,
+
+    // Games with a more unbalanced score after the random opening are discarded
+    DATAGEN_OPENING_SCORE_LIMIT = 400,
+
+    // Number of random openings tried for a game before giving up on the run, which only happens
+    // when the random opening is too long to give playable games
+    DATAGEN_MAX_GAME_ATTEMPTS = 1000,
+
+    // A game is adjudicated as won once both sides agree on a score above this limit in favor of
+    // the same side for DATAGEN_WIN_PLIES consecutive plies
+    DATAGEN_WIN_SCORE = 1000,
+    DATAGEN_WIN_PLIES = 4,
+
+    // A game is adjudicated as drawn once both sides agree on a score below this limit for
+    // DATAGEN_DRAW_PLIES consecutive plies, past the first DATAGEN_DRAW_MIN_PLY plies
+    DATAGEN_DRAW_SCORE = 10,
+    DATAGEN_DRAW_PLIES = 8,
+    DATAGEN_DRAW_MIN_PLY = 80,
+
+    // Games reaching this length are adjudicated as drawn
+    DATAGEN_MAX_GAME_PLIES = 400,
+
+    // Size above which the generated positions get written to the output file
+    DATAGEN_FLUSH_SIZE = 1024 * 1024,
+
+    // Interval at which the generation progress gets reported
+    DATAGEN_REPORT_INTERVAL = 100,
+};
+
+// Struct for the state shared by all datagen threads
+typedef struct {
+    FILE *output;
+    pthread_mutex_t output_mutex;
+    String go_args;
+    usize hash_mb;
+    u64 game_count;
+    u64 random_plies;
+    u64 seed;
+    i64 move_overhead;
+    Timepoint start;
+    _Atomic u64 next_game;
+    u64 finished_games;
+    u64 position_count;
+} DatagenRun;
+
+// Struct for a position recorded during a game, waiting for the game result
+typedef struct {
+    usize fen_offset;
+    usize fen_size;
+    Score score;
+} DatagenRecord;
+
+// Struct for a datagen thread. Each thread plays its games with a single-threaded worker pool of
+// its own, so that games are played independently of each other.
+typedef struct {
+    pthread_t thread;
+    DatagenRun *run;
+    WorkerPool pool;
+    String game_fens;
+    DatagenRecord records[DATAGEN_MAX_GAME_PLIES];
+    usize record_count;
+    String buffer;
+    u64 buffered_positions;
+} DatagenThread;
+
+// Writes the buffered positions to the output file
+static void datagen_flush(DatagenThread *datagen_thread) {
+    DatagenRun *run = datagen_thread->run;
+
+    pthread_mutex_lock(&run->output_mutex);
+    fwrite_string(run->output, &datagen_thread->buffer);
+    fflush(run->output);
+    run->position_count += datagen_thread->buffered_positions;
+    pthread_mutex_unlock(&run->output_mutex);
+
+    string_clear(&datagen_thread->buffer);
+    datagen_thread->buffered_positions = 0;
+}
+
+// Checks if the game is drawn by lack of mating material. Only the trivial cases (bare kings and
+// a single minor piece) are detected here, the other ones are left to the adjudication.
+static bool datagen_material_is_insufficient(const Board *board) {
+    return bb_popcount(board_occupancy_bb(board)) <= 3
+        && !board_piecetypes_bb(board, PAWN, ROOK) && !board_piecetype_bb(board, QUEEN);
+}
+
+// Plays random legal moves from the starting position. Returns false if the game ended during the
+// random opening
+static bool datagen_play_opening(Board *board, u64 random_plies, u64 *seed) {
+    for (u64 ply = 0; ply < random_plies; ++ply) {
+        Movelist movelist;
+
+        movelist_generate_legal(&movelist, board);
+
+        if (movelist_size(&movelist) == 0) {
+            return false;
+        }
+
+        const Move move = movelist.moves[u64_random(seed) % movelist_size(&movelist)];
+
+        board_do_move(board, move, wrap_malloc(sizeof(Boardstack)));
+    }
+
+    return true;
+}
+
+// Plays one game with the given seed. Returns the game result from White's point of view ("1.0",
+// "0.5" or "0.0"), or an empty view if the game must be discarded.
+static StringView datagen_play_game(DatagenThread *datagen_thread, u64 seed) {
+    const DatagenRun *run = datagen_thread->run;
+    WorkerPool *wpool = &datagen_thread->pool;
+    Board board;
+    SearchParams search_params;
+    StringView result = STATIC_STRVIEW("");
+    u16 win_plies = 0;
+    u16 draw_plies = 0;
+    i16 winning_side = 0;
+
+    datagen_thread->record_count = 0;
+    string_clear(&datagen_thread->game_fens);
+    board_try_init(&board, StartposStr, false, wrap_malloc(sizeof(Boardstack)));
+
+    if (!datagen_play_opening(&board, run->random_plies, &seed)) {
+        goto cleanup;
+    }
+
+    // Start each game from clean tables, so that games don't depend on the order in which they are
+    // played. The TT is cleared lazily to keep this cheap.
+    wpool_init_new_game(wpool);
+
+    for (u16 game_ply = 0; result.size == 0; ++game_ply) {
+        Movelist movelist;
+
+        movelist_generate_legal(&movelist, &board);
+
+        if (movelist_size(&movelist) == 0) {
+            const bool white_mated = board.stack->checkers && board.side_to_move == WHITE;
+            const bool black_mated = board.stack->checkers && board.side_to_move == BLACK;
+
+            result = white_mated  ? STATIC_STRVIEW("0.0")
+                   : black_mated ? STATIC_STRVIEW("1.0")
+                                 : STATIC_STRVIEW("0.5");
+            break;
+        }
+
+        if (board.stack->rule50 >= 100 || board.stack->repetition < 0
+            || datagen_material_is_insufficient(&board) || game_ply >= DATAGEN_MAX_GAME_PLIES) {
+            result = STATIC_STRVIEW("0.5");
+            break;
+        }
+
+        search_params_init(&search_params, run->move_overhead, 1, false, false, false);
+        search_params_set_from_uci(&search_params, &board, strview_from_string(&run->go_args));
+        search_params.silent = true;
+        wpool_start_search(wpool, &board, &search_params);
+        wpool_wait_search_completion(wpool);
+
+        const Worker *worker = wpool_main_worker(wpool);
+        const Move bestmove = worker->root_moves[0].move;
+        const Score score = worker->completed_depth != 0 ? worker->completed_score : 0;
+
+        if (game_ply == 0 && i16_abs(score) > DATAGEN_OPENING_SCORE_LIMIT) {
+            goto cleanup;
+        }
+
+        // Only record quiet positions with a non-mate score, as these are the ones the static
+        // evaluation can be tuned on.
+        if (!board.stack->checkers && !board_move_is_noisy(&board, bestmove)
+            && score_is_normal(score)) {
+            DatagenRecord *record = &datagen_thread->records[datagen_thread->record_count++];
+            const StringView fen = board_get_fen(&board);
+
+            record->fen_offset = datagen_thread->game_fens.size;
+            record->fen_size = fen.size;
+            record->score = score;
+            string_push_back_strview(&datagen_thread->game_fens, fen);
+        }
+
+        // The score is given from the side to move's point of view, so convert it to White's point
+        // of view for the win streak to break as soon as the winning side changes.
+        const Score white_score = board.side_to_move == WHITE ? score : -score;
+        const i16 side = white_score >= DATAGEN_WIN_SCORE ? 1
+                       : white_score <= -DATAGEN_WIN_SCORE ? -1
+                                                            : 0;
+
+        win_plies = side != 0 && side == winning_side ? win_plies + 1 : (side != 0);
+        winning_side = side;
+        draw_plies = i16_abs(score) <= DATAGEN_DRAW_SCORE ? draw_plies + 1 : 0;
+
+        if (win_plies >= DATAGEN_WIN_PLIES) {
+            result = winning_side > 0 ? STATIC_STRVIEW("1.0") : STATIC_STRVIEW("0.0");
+        } else if (draw_plies >= DATAGEN_DRAW_PLIES && game_ply >= DATAGEN_DRAW_MIN_PLY) {
+            result = STATIC_STRVIEW("0.5");
+        }
+
+        board_do_move(&board, bestmove, wrap_malloc(sizeof(Boardstack)));
+    }
+
+    // Write the positions in the format expected by tuner_dataset_add_file().
+    for (usize i = 0; i < datagen_thread->record_count; ++i) {
+        const DatagenRecord *record = &datagen_thread->records[i];
+
+        string_push_back_range(
+            &datagen_thread->buffer,
+            datagen_thread->game_fens.data + record->fen_offset,
+            record->fen_size
+        );
+        string_push_back(&datagen_thread->buffer, ' ');
+        string_push_back_strview(&datagen_thread->buffer, result);
+        string_push_back(&datagen_thread->buffer, ' ');
+        string_push_back_i64(&datagen_thread->buffer, record->score);
+        string_push_back(&datagen_thread->buffer, '\n');
+    }
+
+    datagen_thread->buffered_positions += datagen_thread->record_count;
+
+cleanup:
+    boardstack_destroy(board.stack);
+    return result;
+}
+
+static void *datagen_thread_entry_point(void *datagen_thread_ptr) {
+    DatagenThread *datagen_thread = (DatagenThread *)datagen_thread_ptr;
+    DatagenRun *run = datagen_thread->run;
+    u64 game_index;
+
+    while ((game_index = atomic_fetch_add_explicit(&run->next_game, 1, memory_order_relaxed))
+           < run->game_count) {
+        // Derive the seed from the game index, so that the generated games don't depend on the
+        // number of threads.
+        u64 seed = (run->seed + game_index * U64(0x9E3779B97F4A7C15)) | 1;
+        u64 attempts = 0;
+
+        // Discarded games are replayed with another random opening.
+        while (datagen_play_game(datagen_thread, u64_random(&seed)).size == 0
+               && ++attempts < DATAGEN_MAX_GAME_ATTEMPTS) {}
+
+        if (attempts == DATAGEN_MAX_GAME_ATTEMPTS) {
+            // Make all threads stop after their current game.
+            atomic_store_explicit(&run->next_game, run->game_count, memory_order_relaxed);
+            sync_lock_stdout();
+            printf(
+                "info string Error: no playable game after " FORMAT_LARGE_INT
+                " random openings of " FORMAT_LARGE_INT " plies, stopping\n",
+                (LargeInt)DATAGEN_MAX_GAME_ATTEMPTS,
+                (LargeInt)run->random_plies
+            );
+            fflush(stdout);
+            sync_unlock_stdout();
+            break;
+        }
+
+        if (datagen_thread->buffer.size >= DATAGEN_FLUSH_SIZE) {
+            datagen_flush(datagen_thread);
+        }
+
+        pthread_mutex_lock(&run->output_mutex);
+        const u64 finished_games = ++run->finished_games;
+        const u64 position_count = run->position_count;
+        pthread_mutex_unlock(&run->output_mutex);
+
+        if (finished_games % DATAGEN_REPORT_INTERVAL == 0) {
+            sync_lock_stdout();
+            printf(
+                "info string Played " FORMAT_LARGE_INT " games, wrote " FORMAT_LARGE_INT
+                " positions in " FORMAT_LARGE_INT " ms\n",
+                (LargeInt)finished_games,
+                (LargeInt)position_count,
+                (LargeInt)timepoint_diff(run->start, timepoint_now())
+            );
+            fflush(stdout);
+            sync_unlock_stdout();
+        }
+    }
+
+    datagen_flush(datagen_thread);
+    return NULL;
+}
+
+void uci_datagen(Uci *uci, StringView args) {
+    DatagenRun run;
+    u64 depth = 0;
+    u64 nodes = 0;
+    u64 thread_count = (u64)uci->option_values.threads;
+    u64 hash_mb = DATAGEN_DEFAULT_HASH;
+    StringView filename = strview_next_word(&args);
+
+    wpool_wait_search_completion(&uci->worker_pool);
+
+    run.game_count = DATAGEN_DEFAULT_GAMES;
+    run.random_plies = DATAGEN_DEFAULT_RANDOM_PLIES;
+    run.seed = (u64)timepoint_now();
+
+    while (true) {
+        const StringView token = strview_next_word(&args);
+        u64 value;
+
+        if (token.size == 0) {
+            break;
+        }
+
+        if (!strview_parse_u64(strview_next_word(&args), &value)) {
+            info_debug(
+                "info string Error: missing value for datagen parameter '%.*s'\n",
+                (int)token.size,
+                (const char *)token.data
+            );
+            continue;
+        }
+
+        if (strview_equals_strview(token, STATIC_STRVIEW("games"))) {
+            run.game_count = value;
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("depth"))) {
+            depth = u64_min(value, MAX_PLIES);
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("nodes"))) {
+            nodes = value;
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("threads"))) {
+            thread_count = u64_max(value, 1);
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("hash"))) {
+            hash_mb = u64_max(value, 1);
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("random_plies"))) {
+            run.random_plies = u64_min(value, DATAGEN_MAX_GAME_PLIES);
+        } else if (strview_equals_strview(token, STATIC_STRVIEW("seed"))) {
+            run.seed = value;
+        } else {
+            info_debug(
+                "info string Error: unknown datagen parameter '%.*s'\n",
+                (int)token.size,
+                (const char *)token.data
+            );
+        }
+    }
+
+    if (filename.size != 0) {
+        String filename_str;
+
+        string_init_from_strview(&filename_str, filename);
+        string_push_back(&filename_str, '\0');
+        run.output = fopen((const char *)filename_str.data, "a");
+
+        if (run.output == NULL) {
+            sync_lock_stdout();
+            printf("info string Unable to open '%s'\n", (const char *)filename_str.data);
+            fflush(stdout);
+            sync_unlock_stdout();
+        }
+
+        string_destroy(&filename_str);
+    }
+
+    if (filename.size == 0 || run.output == NULL) {
+        sync_lock_stdout();
+        puts(
+            "info string Usage: datagen <output> [games <g>] [depth <d>] [nodes <n>] "
+            "[threads <t>] [hash <mb>] [random_plies <r>] [seed <s>]"
+        );
+        fflush(stdout);
+        sync_unlock_stdout();
+        return;
+    }
+
+    // Fall back to a fixed node count if no search limit was given.
+    if (depth == 0 && nodes == 0) {
+        nodes = DATAGEN_DEFAULT_NODES;
+    }
+
+    string_init(&run.go_args);
+
+    if (depth != 0) {
+        string_push_back_strview(&run.go_args, STATIC_STRVIEW("depth "));
+        string_push_back_u64(&run.go_args, depth);
+    }
+
+    if (nodes != 0) {
+        string_push_back_strview(&run.go_args, STATIC_STRVIEW(" nodes "));
+        string_push_back_u64(&run.go_args, nodes);
+    }
+
+    run.hash_mb = (usize)hash_mb;
+    run.move_overhead = uci->option_values.move_overhead;
+    run.finished_games = 0;
+    run.position_count = 0;
+    atomic_init(&run.next_game, 0);
+
+    if (pthread_mutex_init(&run.output_mutex, NULL)) {
+        perror("Unable to initialize datagen lock");
+        exit(EXIT_FAILURE);
+    }
+
+    sync_lock_stdout();
+    printf(
+        "info string Generating " FORMAT_LARGE_INT " games with seed " FORMAT_LARGE_INT "\n",
+        (LargeInt)run.game_count,
+        (LargeInt)run.seed
+    );
+    fflush(stdout);
+    sync_unlock_stdout();
+
+    DatagenThread *thread_list = wrap_malloc(sizeof(DatagenThread) * thread_count);
+
+    run.start = timepoint_now();
+
+    for (usize i = 0; i < thread_count; ++i) {
+        DatagenThread *datagen_thread = &thread_list[i];
+
+        datagen_thread->run = &run;
+        datagen_thread->buffered_positions = 0;
+        string_init(&datagen_thread->game_fens);
+        string_init(&datagen_thread->buffer);
+        string_reserve(&datagen_thread->buffer, DATAGEN_FLUSH_SIZE * 2);
+        wpool_init(&datagen_thread->pool, i, run.hash_mb, true);
+
+        if (pthread_create(
+                &datagen_thread->thread,
+                NULL,
+                datagen_thread_entry_point,
+                datagen_thread
+            )) {
+            perror("Unable to create datagen threads");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (usize i = 0; i < thread_count; ++i) {
+        pthread_join(thread_list[i].thread, NULL);
+        wpool_destroy(&thread_list[i].pool);
+        string_destroy(&thread_list[i].game_fens);
+        string_destroy(&thread_list[i].buffer);
+    }
+
+    const Duration elapsed = timepoint_diff(run.start, timepoint_now());
+
+    sync_lock_stdout();
+    printf(
+        "info string Played " FORMAT_LARGE_INT " games, wrote " FORMAT_LARGE_INT
+        " positions in " FORMAT_LARGE_INT " ms\n",
+        (LargeInt)run.finished_games,
+        (LargeInt)run.position_count,
+        (LargeInt)elapsed
+    );
+    fflush(stdout);
+    sync_unlock_stdout();
+
+    free(thread_list);
+    pthread_mutex_destroy(&run.output_mutex);
+    string_destroy(&run.go_args);
+    fclose(run.output);
+}
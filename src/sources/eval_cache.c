@@ -0,0 +1,55 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "eval_cache.h"
+
+#include <string.h>
+
+#include "wmalloc.h"
+
+void eval_cache_init(EvalCache *cache) {
+    cache->entries = NULL;
+    cache->entry_count = 0;
+}
+
+void eval_cache_destroy(EvalCache *cache) {
+    if (cache->entries != NULL) {
+        wrap_aligned_free(cache->entries);
+    }
+
+    eval_cache_init(cache);
+}
+
+void eval_cache_resize(EvalCache *cache, usize size_kb) {
+    eval_cache_destroy(cache);
+    cache->entry_count = size_kb * 1024 / sizeof(EvalCacheEntry);
+
+    if (cache->entry_count != 0) {
+        cache->entry_count = (usize)1 << u64_last_one(cache->entry_count);
+    }
+
+    cache->entries = cache->entry_count != 0
+        ? wrap_aligned_alloc(64, cache->entry_count * sizeof(EvalCacheEntry))
+        : NULL;
+}
+
+void eval_cache_clear(EvalCache *cache) {
+    if (cache->entries != NULL) {
+        memset(cache->entries, 0, cache->entry_count * sizeof(EvalCacheEntry));
+    }
+}
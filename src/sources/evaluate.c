@@ -23,11 +23,15 @@
 #include "attacks.h"
 #include "endgame.h"
 #include "kp_eval.h"
+#include "material.h"
 #include "movelist.h"
 #include "psq_table.h"
 
 EvalTrace Trace;
 
+// Margin for the lazy evaluation, zero if disabled
+static Score LazyMargin = 0;
+
 // clang-format off
 
 // Special eval terms
@@ -184,15 +188,6 @@ static bool opposite_colored_bishops(Bitboard bishops) {
     return (bishops & DSQ_BB) && (bishops & LSQ_BB);
 }
 
-static bool is_kxk_endgame(const Board *board, Color us) {
-    // If the weak side has pieces or Pawns, this is not a KXK endgame.
-    if (bb_more_than_one(board_color_bb(board, color_flip(us)))) {
-        return false;
-    }
-
-    return board->stack->material[us] >= ROOK_MG_SCORE;
-}
-
 static Score eval_kxk(const Board *board, Color us) {
     // Be careful to avoid stalemating the weak King.
     if (board->side_to_move != us && !board->stack->checkers) {
@@ -843,7 +838,12 @@ static bool eval_is_ocb_endgame(const Board *board) {
     return opposite_colored_bishops(board_piecetype_bb(board, BISHOP));
 }
 
-static Score eval_scale_endgame(const Board *board, const KingPawnEntry *kpe, Score eg) {
+static Score eval_scale_endgame(
+    const Board *board,
+    const KingPawnEntry *kpe,
+    const MaterialEntry *me,
+    Score eg
+) {
     // Only detect endgame scaling from the side with a positive evaluation. This allows us to
     // quickly filter out positions which shouldn't be scaled, even though they have a theoretical
     // scaling factor in our code (like KNvKPPPP).
@@ -853,7 +853,6 @@ static Score eval_scale_endgame(const Board *board, const KingPawnEntry *kpe, Sc
     const Score weak_material = board->stack->material[weak_side];
     const Bitboard strong_pawns = board_piece_bb(board, strong_side, PAWN);
     const Bitboard weak_pawns = board_piece_bb(board, weak_side, PAWN);
-    const EndgameEntry *entry;
     Scalefactor factor;
 
     // Scale down endgames with no pawns and low material difference.
@@ -877,8 +876,8 @@ static Score eval_scale_endgame(const Board *board, const KingPawnEntry *kpe, Sc
         factor = 130;
     }
     // Check if we have a specialized function for the given material distribution.
-    else if ((entry = endgame_probe_scale(board)) != NULL) {
-        factor = entry->scale_fn(board, strong_side);
+    else if (me->scale_entry != NULL) {
+        factor = me->scale_entry->scale_fn(board, strong_side);
     }
     // Other endgames.
     else {
@@ -889,29 +888,74 @@ static Score eval_scale_endgame(const Board *board, const KingPawnEntry *kpe, Sc
     return (Score)((i32)eg * factor / SCALE_NORMAL);
 }
 
+// Interpolates between the middlegame and endgame scores based on the game phase
+static Score interpolate_phase(Score mg, Score eg, i16 phase) {
+    return (Score)(mg * (phase - ENDGAME_COUNT) / (MIDGAME_COUNT - ENDGAME_COUNT)
+                   + eg * (MIDGAME_COUNT - phase) / (MIDGAME_COUNT - ENDGAME_COUNT));
+}
+
+void evaluate_set_lazy_margin(Score margin) {
+    LazyMargin = margin;
+}
+
 Score evaluate(const Board *board) {
+    bool exact;
+
+    return evaluate_in_window(board, -INF_SCORE, INF_SCORE, &exact);
+}
+
+Score evaluate_in_window(const Board *board, Score alpha, Score beta, bool *exact) {
+    *exact = true;
     trace_init();
 
-    // Do we have a specialized endgame eval for the current configuration ?
-    const EndgameEntry *entry = endgame_probe_score(board);
+    const MaterialEntry *me = material_probe(board);
 
-    if (entry != NULL) {
-        return entry->score_fn(board, entry->strong_side);
+    // Do we have a specialized endgame eval for the current configuration ?
+    if (me->score_entry != NULL) {
+        return me->score_entry->score_fn(board, me->score_entry->strong_side);
     }
 
     // Is there a KXK situation ? (lone King vs mating material)
-    if (is_kxk_endgame(board, WHITE)) {
-        return eval_kxk(board, WHITE);
+    if (me->kxk_side != COLOR_NB) {
+        return eval_kxk(board, me->kxk_side);
     }
 
-    if (is_kxk_endgame(board, BLACK)) {
-        return eval_kxk(board, BLACK);
+    if (board->accumulator != NULL) {
+#ifndef NDEBUG
+        NnueAccumulator refreshed;
+
+        nnue_accumulator_refresh(&refreshed, board->mailbox);
+        assert(!memcmp(&refreshed, board->accumulator, sizeof(NnueAccumulator)));
+#endif
+        return nnue_evaluate(board->accumulator, board->side_to_move);
     }
 
     EvaluationData evaldata;
     Scorepair tapered = board->psq_scorepair;
     KingPawnEntry *kpe;
 
+    // Add the King-Pawn structure evaluation.
+    kpe = king_pawn_probe(board);
+    tapered += kpe->value;
+
+    // Lazy evaluation. If the cheap terms put us far enough outside the window, assume that the
+    // remaining terms won't bring the score back into it. The Initiative bonus and the endgame
+    // scaling are applied like in the full evaluation, since scaled endgames could otherwise land
+    // far outside the window with a real eval close to zero.
+    if (LazyMargin != 0) {
+        const Scorepair lazy_tapered =
+            tapered + (board->side_to_move == WHITE ? Initiative : -Initiative);
+        const Score lazy_eg = eval_scale_endgame(board, kpe, me, scorepair_endgame(lazy_tapered));
+        Score lazy_score = interpolate_phase(scorepair_midgame(lazy_tapered), lazy_eg, me->phase);
+
+        lazy_score = board->side_to_move == WHITE ? lazy_score : -lazy_score;
+
+        if (lazy_score <= alpha - LazyMargin || lazy_score >= beta + LazyMargin) {
+            *exact = false;
+            return lazy_score;
+        }
+    }
+
     // Initialize the evaldata structure.
     memset(&evaldata, 0, sizeof(evaldata));
     evaldata_init(&evaldata, board, WHITE);
@@ -920,10 +964,6 @@ Score evaluate(const Board *board) {
     evaldata_init_next(&evaldata, board, BLACK);
     evaldata_set_position_closed(&evaldata, board);
 
-    // Add the King-Pawn structure evaluation.
-    kpe = king_pawn_probe(board);
-    tapered += kpe->value;
-
     // Add the pieces' evaluation.
     tapered += evaluate_knights(board, &evaldata, kpe, WHITE);
     tapered -= evaluate_knights(board, &evaldata, kpe, BLACK);
@@ -951,21 +991,14 @@ Score evaluate(const Board *board) {
     trace_add(IDX_INITIATIVE, board->side_to_move, 1);
 
     Score mg = scorepair_midgame(tapered);
-    Score eg = eval_scale_endgame(board, kpe, scorepair_endgame(tapered));
+    Score eg = eval_scale_endgame(board, kpe, me, scorepair_endgame(tapered));
     Score score;
 
     trace_set_eval(tapered);
 
     // Compute the evaluation by interpolating between the middlegame and endgame scores.
-    {
-        i16 phase = 4 * board_piecetype_count(board, QUEEN) + 2 * board_piecetype_count(board, ROOK)
-            + board_piecetype_count(board, BISHOP) + board_piecetype_count(board, KNIGHT);
-
-        phase = i16_clamp(phase, ENDGAME_COUNT, MIDGAME_COUNT);
-        trace_set_phase(phase);
-        score = mg * (phase - ENDGAME_COUNT) / (MIDGAME_COUNT - ENDGAME_COUNT);
-        score += eg * (MIDGAME_COUNT - phase) / (MIDGAME_COUNT - ENDGAME_COUNT);
-    }
+    trace_set_phase(me->phase);
+    score = interpolate_phase(mg, eg, me->phase);
 
     // Return the score relative to the side to move.
     return board->side_to_move == WHITE ? score : -score;
@@ -18,8 +18,11 @@
 
 #include "kp_eval.h"
 
+#include <string.h>
+
 #include "attacks.h"
 #include "evaluate.h"
+#include "wmalloc.h"
 #include "worker.h"
 
 // clang-format off
@@ -249,6 +252,30 @@ static Scorepair evaluate_doubled_isolated(Bitboard our_pawns, Color us __attrib
     return ret;
 }
 
+void king_pawn_table_init(KingPawnTable *table) {
+    table->entries = NULL;
+    table->entry_count = 0;
+}
+
+void king_pawn_table_destroy(KingPawnTable *table) {
+    if (table->entries != NULL) {
+        wrap_aligned_free(table->entries);
+    }
+
+    king_pawn_table_init(table);
+}
+
+void king_pawn_table_resize(KingPawnTable *table, usize size_kb) {
+    king_pawn_table_destroy(table);
+    table->entry_count =
+        (usize)1 << u64_last_one(usize_max(size_kb * 1024 / sizeof(KingPawnEntry), 1));
+    table->entries = wrap_aligned_alloc(64, table->entry_count * sizeof(KingPawnEntry));
+}
+
+void king_pawn_table_clear(KingPawnTable *table) {
+    memset(table->entries, 0, table->entry_count * sizeof(KingPawnEntry));
+}
+
 KingPawnEntry *king_pawn_probe(const Board *board) {
     // Required if we are calling evaluate() from the UCI thread or during tuning runs.
     static KingPawnEntry nocache;
@@ -257,11 +284,14 @@ KingPawnEntry *king_pawn_probe(const Board *board) {
     if (!board->has_worker) {
         kpe = &nocache;
     } else {
-        kpe = &board_get_worker(board)
-                   ->king_pawn_table->entry[board->stack->king_pawn_key % KING_PAWN_ENTRY_NB];
+        Worker *worker = board_get_worker(board);
+
+        kpe = king_pawn_entry_at(&worker->king_pawn_table, board->stack->king_pawn_key);
+        search_stats_inc(worker, king_pawn_probes);
 
         // Check if this pawn structure has already been evaluated.
         if (kpe->key == board->stack->king_pawn_key) {
+            search_stats_inc(worker, king_pawn_hits);
             return kpe;
         }
     }
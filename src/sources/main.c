@@ -25,6 +25,7 @@
 #include "endgame.h"
 #include "hashkey.h"
 #include "kpk_bitbase.h"
+#include "numa.h"
 #include "psq_table.h"
 #include "search.h"
 #include "syncio.h"
@@ -33,6 +34,7 @@
 
 int main(int argc, char **argv) {
     sync_init();
+    numa_init();
     bitboard_init();
     zobrist_init();
     psq_table_init();
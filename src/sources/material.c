@@ -0,0 +1,69 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "material.h"
+
+#include "evaluate.h"
+#include "psq_table.h"
+#include "worker.h"
+
+static bool is_kxk_endgame(const Board *board, Color us) {
+    // If the weak side has pieces or Pawns, this is not a KXK endgame.
+    if (bb_more_than_one(board_color_bb(board, color_flip(us)))) {
+        return false;
+    }
+
+    return board->stack->material[us] >= ROOK_MG_SCORE;
+}
+
+const MaterialEntry *material_probe(const Board *board) {
+    // Required if we are calling evaluate() from the UCI thread or during tuning runs.
+    static MaterialEntry nocache;
+    MaterialEntry *me;
+
+    if (!board->has_worker) {
+        me = &nocache;
+    } else {
+        me = material_entry_at(board_get_worker(board)->material_table, board->stack->material_key);
+
+        // Check if this material configuration has already been seen.
+        if (me->key == board->stack->material_key) {
+            return me;
+        }
+    }
+
+    me->key = board->stack->material_key;
+    me->score_entry = endgame_probe_score(board);
+    me->scale_entry = endgame_probe_scale(board);
+
+    // Check for KXK situations (lone King vs mating material).
+    if (is_kxk_endgame(board, WHITE)) {
+        me->kxk_side = WHITE;
+    } else if (is_kxk_endgame(board, BLACK)) {
+        me->kxk_side = BLACK;
+    } else {
+        me->kxk_side = COLOR_NB;
+    }
+
+    const i16 phase = 4 * board_piecetype_count(board, QUEEN)
+        + 2 * board_piecetype_count(board, ROOK) + board_piecetype_count(board, BISHOP)
+        + board_piecetype_count(board, KNIGHT);
+
+    me->phase = i16_clamp(phase, ENDGAME_COUNT, MIDGAME_COUNT);
+    return me;
+}
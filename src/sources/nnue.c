@@ -0,0 +1,334 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "nnue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+#include "wmalloc.h"
+
+// Struct for the quantized network parameters
+typedef struct {
+    _Alignas(64) i16 feature_weights[NNUE_INPUT_SIZE][NNUE_HIDDEN_SIZE];
+    _Alignas(64) i16 feature_biases[NNUE_HIDDEN_SIZE];
+    _Alignas(64) i16 output_weights[COLOR_NB][NNUE_HIDDEN_SIZE];
+    i32 output_bias;
+} NnueNetwork;
+
+static NnueNetwork *Network = NULL;
+static bool NnueEnabled = false;
+
+// Returns the input index of the given piece from the given perspective. Pieces are seen relative
+// to the perspective, so that both perspectives share the same weights.
+INLINED usize feature_index(Color perspective, Piece piece, Square square) {
+    return (usize)(piece_color(piece) != perspective) * 384 + (usize)(piece_type(piece) - PAWN) * 64
+        + square_relative(square, perspective);
+}
+
+// The kernels below work on full hidden layer rows. The hidden layer size must be a multiple of
+// the widest vector size.
+static_assert(NNUE_HIDDEN_SIZE % 16 == 0, "Hidden layer size must be a multiple of 16");
+
+static void row_add(i16 *restrict acc, const i16 *restrict row) {
+#if defined(__AVX2__)
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; i += 16) {
+        const __m256i v = _mm256_load_si256((const __m256i *)(acc + i));
+
+        _mm256_store_si256(
+            (__m256i *)(acc + i),
+            _mm256_add_epi16(v, _mm256_load_si256((const __m256i *)(row + i)))
+        );
+    }
+#elif defined(__SSE4_1__)
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; i += 8) {
+        const __m128i v = _mm_load_si128((const __m128i *)(acc + i));
+
+        _mm_store_si128(
+            (__m128i *)(acc + i),
+            _mm_add_epi16(v, _mm_load_si128((const __m128i *)(row + i)))
+        );
+    }
+#else
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; ++i) {
+        acc[i] += row[i];
+    }
+#endif
+}
+
+static void row_sub(i16 *restrict acc, const i16 *restrict row) {
+#if defined(__AVX2__)
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; i += 16) {
+        const __m256i v = _mm256_load_si256((const __m256i *)(acc + i));
+
+        _mm256_store_si256(
+            (__m256i *)(acc + i),
+            _mm256_sub_epi16(v, _mm256_load_si256((const __m256i *)(row + i)))
+        );
+    }
+#elif defined(__SSE4_1__)
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; i += 8) {
+        const __m128i v = _mm_load_si128((const __m128i *)(acc + i));
+
+        _mm_store_si128(
+            (__m128i *)(acc + i),
+            _mm_sub_epi16(v, _mm_load_si128((const __m128i *)(row + i)))
+        );
+    }
+#else
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; ++i) {
+        acc[i] -= row[i];
+    }
+#endif
+}
+
+static void row_add_sub(i16 *restrict acc, const i16 *restrict add, const i16 *restrict sub) {
+#if defined(__AVX2__)
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; i += 16) {
+        __m256i v = _mm256_load_si256((const __m256i *)(acc + i));
+
+        v = _mm256_add_epi16(v, _mm256_load_si256((const __m256i *)(add + i)));
+        v = _mm256_sub_epi16(v, _mm256_load_si256((const __m256i *)(sub + i)));
+        _mm256_store_si256((__m256i *)(acc + i), v);
+    }
+#elif defined(__SSE4_1__)
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; i += 8) {
+        __m128i v = _mm_load_si128((const __m128i *)(acc + i));
+
+        v = _mm_add_epi16(v, _mm_load_si128((const __m128i *)(add + i)));
+        v = _mm_sub_epi16(v, _mm_load_si128((const __m128i *)(sub + i)));
+        _mm_store_si128((__m128i *)(acc + i), v);
+    }
+#else
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; ++i) {
+        acc[i] += add[i] - sub[i];
+    }
+#endif
+}
+
+// Computes the dot product of the clipped accumulator values with the output weights
+static i32 row_crelu_dot(const i16 *restrict acc, const i16 *restrict weights) {
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i qa = _mm256_set1_epi16(NNUE_QA);
+    __m256i sum = _mm256_setzero_si256();
+
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; i += 16) {
+        __m256i v = _mm256_load_si256((const __m256i *)(acc + i));
+
+        v = _mm256_min_epi16(_mm256_max_epi16(v, zero), qa);
+        sum = _mm256_add_epi32(
+            sum,
+            _mm256_madd_epi16(v, _mm256_load_si256((const __m256i *)(weights + i)))
+        );
+    }
+
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum128);
+#elif defined(__SSE4_1__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i qa = _mm_set1_epi16(NNUE_QA);
+    __m128i sum = _mm_setzero_si128();
+
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; i += 8) {
+        __m128i v = _mm_load_si128((const __m128i *)(acc + i));
+
+        v = _mm_min_epi16(_mm_max_epi16(v, zero), qa);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(v, _mm_load_si128((const __m128i *)(weights + i))));
+    }
+
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+#else
+    i32 sum = 0;
+
+    for (usize i = 0; i < NNUE_HIDDEN_SIZE; ++i) {
+        sum += (i32)i16_clamp(acc[i], 0, NNUE_QA) * weights[i];
+    }
+
+    return sum;
+#endif
+}
+
+void nnue_accumulator_refresh(NnueAccumulator *accumulator, const Piece *mailbox) {
+    for (Color c = WHITE; c <= BLACK; ++c) {
+        memcpy(accumulator->values[c], Network->feature_biases, sizeof(Network->feature_biases));
+    }
+
+    for (Square square = SQ_A1; square <= SQ_H8; ++square) {
+        if (mailbox[square] != NO_PIECE) {
+            nnue_accumulator_add(accumulator, mailbox[square], square);
+        }
+    }
+}
+
+void nnue_accumulator_add(NnueAccumulator *accumulator, Piece piece, Square square) {
+    for (Color c = WHITE; c <= BLACK; ++c) {
+        row_add(accumulator->values[c], Network->feature_weights[feature_index(c, piece, square)]);
+    }
+}
+
+void nnue_accumulator_remove(NnueAccumulator *accumulator, Piece piece, Square square) {
+    for (Color c = WHITE; c <= BLACK; ++c) {
+        row_sub(accumulator->values[c], Network->feature_weights[feature_index(c, piece, square)]);
+    }
+}
+
+void nnue_accumulator_move(NnueAccumulator *accumulator, Piece piece, Square from, Square to) {
+    for (Color c = WHITE; c <= BLACK; ++c) {
+        row_add_sub(
+            accumulator->values[c],
+            Network->feature_weights[feature_index(c, piece, to)],
+            Network->feature_weights[feature_index(c, piece, from)]
+        );
+    }
+}
+
+Score nnue_evaluate(const NnueAccumulator *accumulator, Color side_to_move) {
+    const i32 output = row_crelu_dot(accumulator->values[side_to_move], Network->output_weights[0])
+        + row_crelu_dot(accumulator->values[color_flip(side_to_move)], Network->output_weights[1])
+        + Network->output_bias;
+
+    // Keep the score away from the range of known wins.
+    return (Score)i32_clamp(
+        (i32)((i64)output * NNUE_OUTPUT_SCALE / (NNUE_QA * NNUE_QB)),
+        -VICTORY + 1,
+        VICTORY - 1
+    );
+}
+
+// Reads a little-endian 32-bit value from the file
+static bool read_u32(FILE *f, u32 *value) {
+    u8 bytes[4];
+
+    if (fread(bytes, 1, 4, f) != 4) {
+        return false;
+    }
+
+    *value = (u32)bytes[0] | (u32)bytes[1] << 8 | (u32)bytes[2] << 16 | (u32)bytes[3] << 24;
+    return true;
+}
+
+// Reads an array of little-endian 16-bit values from the file
+static bool read_i16_array(FILE *f, i16 *values, usize count) {
+    u8 bytes[512];
+
+    while (count != 0) {
+        const usize chunk = usize_min(count, sizeof(bytes) / 2);
+
+        if (fread(bytes, 2, chunk, f) != chunk) {
+            return false;
+        }
+
+        for (usize i = 0; i < chunk; ++i) {
+            values[i] = (i16)((u16)bytes[2 * i] | (u16)bytes[2 * i + 1] << 8);
+        }
+
+        values += chunk;
+        count -= chunk;
+    }
+
+    return true;
+}
+
+NnueLoadStatus nnue_load(const char *filename) {
+    // File layout: the "STNN" magic, followed by the format version, the input and hidden layer
+    // sizes, the feature weights and biases, the output weights (side to move first) and the
+    // output bias. All values are stored in little-endian order.
+    FILE *f = fopen(filename, "rb");
+    NnueNetwork *network;
+    char magic[4];
+    u32 version, input_size, hidden_size, output_bias;
+    NnueLoadStatus status = NnueLoadOk;
+
+    if (f == NULL) {
+        return NnueLoadOpenFailed;
+    }
+
+    network = wrap_aligned_alloc(64, sizeof(NnueNetwork));
+
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, "STNN", 4) || !read_u32(f, &version)) {
+        status = NnueLoadBadHeader;
+    } else if (version != NNUE_VERSION) {
+        status = NnueLoadBadVersion;
+    } else if (!read_u32(f, &input_size) || !read_u32(f, &hidden_size)) {
+        status = NnueLoadBadHeader;
+    } else if (input_size != NNUE_INPUT_SIZE || hidden_size != NNUE_HIDDEN_SIZE) {
+        status = NnueLoadBadTopology;
+    } else if (!read_i16_array(
+                   f,
+                   &network->feature_weights[0][0],
+                   NNUE_INPUT_SIZE * NNUE_HIDDEN_SIZE
+               )
+               || !read_i16_array(f, network->feature_biases, NNUE_HIDDEN_SIZE)
+               || !read_i16_array(f, &network->output_weights[0][0], COLOR_NB * NNUE_HIDDEN_SIZE)
+               || !read_u32(f, &output_bias) || fgetc(f) != EOF) {
+        status = NnueLoadTruncated;
+    }
+
+    fclose(f);
+
+    if (status != NnueLoadOk) {
+        wrap_aligned_free(network);
+        return status;
+    }
+
+    network->output_bias = (i32)output_bias;
+    nnue_unload();
+    Network = network;
+    return NnueLoadOk;
+}
+
+const char *nnue_load_status_name(NnueLoadStatus status) {
+    static const char *StatusNames[] = {
+        "loaded",
+        "unable to open file",
+        "not a network file",
+        "unsupported network version",
+        "unsupported network topology",
+        "truncated or oversized file",
+    };
+
+    return StatusNames[status];
+}
+
+void nnue_unload(void) {
+    if (Network != NULL) {
+        wrap_aligned_free(Network);
+        Network = NULL;
+    }
+}
+
+void nnue_set_enabled(bool state) {
+    NnueEnabled = state;
+}
+
+bool nnue_is_active(void) {
+    return NnueEnabled && Network != NULL;
+}
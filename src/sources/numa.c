@@ -0,0 +1,432 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Required for the CPU affinity API on Linux.
+#define _GNU_SOURCE
+
+#include "numa.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "syncio.h"
+
+// Memory policy modes, as defined in <linux/mempolicy.h>. We don't include the header directly
+// since it isn't always shipped with the libc headers.
+enum {
+    NUMA_MPOL_PREFERRED = 1,
+    NUMA_MPOL_INTERLEAVE = 3,
+    NUMA_MASK_WORDS = NUMA_MAX_NODES / 64,
+};
+
+// Struct describing where a CPU sits in the host, used for ordering CPUs when pinning threads
+typedef struct {
+    u16 cpu_id;
+    u16 node;
+    u16 core_rank;
+    u16 smt_index;
+} CpuInfo;
+#endif
+
+// Struct describing the NUMA layout of the host
+typedef struct {
+    usize node_count;
+#if defined(__linux__)
+    usize node_ids[NUMA_MAX_NODES];
+    cpu_set_t node_cpus[NUMA_MAX_NODES];
+    usize cpu_count;
+    CpuInfo cpus[CPU_SETSIZE];
+#endif
+} NumaTopology;
+
+static NumaTopology Topology;
+static atomic_bool NumaEnabled;
+
+#if defined(__linux__)
+// CPUs assigned to worker threads in pool order. An empty list disables pinning.
+static usize BindingCpuCount;
+static u16 BindingCpus[CPU_SETSIZE];
+#endif
+
+#if defined(__linux__)
+// Parses a Linux-style ID list (e.g. "0-3,8,10-11") into the given set
+static bool parse_id_list(StringView list, cpu_set_t *set) {
+    CPU_ZERO(set);
+    list = strview_trim_whitespaces(list);
+
+    while (list.size != 0) {
+        usize comma = strview_find(list, ',');
+        StringView range = strview_subview(list, 0, comma == NPOS ? list.size : comma);
+        usize dash = strview_find(range, '-');
+        u64 first, last;
+
+        list = comma == NPOS ? EmptyStrview : strview_subview(list, comma + 1, list.size);
+
+        if (dash == NPOS) {
+            if (!strview_parse_u64(range, &first)) {
+                return false;
+            }
+
+            last = first;
+        } else if (!strview_parse_u64(strview_subview(range, 0, dash), &first)
+                   || !strview_parse_u64(strview_subview(range, dash + 1, range.size), &last)) {
+            return false;
+        }
+
+        for (u64 id = first; id <= last && id < CPU_SETSIZE; ++id) {
+            CPU_SET(id, set);
+        }
+    }
+
+    return true;
+}
+
+static bool read_id_list(const char *path, cpu_set_t *set) {
+    FILE *f = fopen(path, "r");
+    String line;
+    bool success;
+
+    if (f == NULL) {
+        return false;
+    }
+
+    string_init(&line);
+    success = string_getline(f, &line) != 0 && parse_id_list(strview_from_string(&line), set);
+    string_destroy(&line);
+    fclose(f);
+    return success;
+}
+
+// Returns the index of the node containing the given CPU
+static u16 cpu_node(usize cpu_id) {
+    for (usize i = 0; i < Topology.node_count; ++i) {
+        if (CPU_ISSET(cpu_id, &Topology.node_cpus[i])) {
+            return (u16)i;
+        }
+    }
+
+    return 0;
+}
+
+static bool numa_init_nodes(const cpu_set_t *process_cpus) {
+    cpu_set_t online_nodes;
+    usize node_count = 0;
+
+    if (!read_id_list("/sys/devices/system/node/online", &online_nodes)) {
+        return false;
+    }
+
+    // Node ids index the fixed-size node masks given to mbind(), so nodes with larger ids are
+    // ignored, and their CPUs are treated as part of the first node.
+    for (usize node_id = 0; node_id < NUMA_MAX_NODES; ++node_id) {
+        char path[64];
+        cpu_set_t *node_cpus = &Topology.node_cpus[node_count];
+
+        if (!CPU_ISSET(node_id, &online_nodes)) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%zu/cpulist", node_id);
+
+        if (!read_id_list(path, node_cpus)) {
+            return false;
+        }
+
+        // Only keep nodes on which we're allowed to run, skipping memory-only nodes.
+        CPU_AND(node_cpus, node_cpus, process_cpus);
+
+        if (CPU_COUNT(node_cpus) != 0) {
+            Topology.node_ids[node_count++] = node_id;
+        }
+    }
+
+    Topology.node_count = usize_max(node_count, 1);
+    return true;
+}
+
+static void numa_init_cpus(const cpu_set_t *process_cpus) {
+    // The lowest SMT sibling of each CPU identifies its physical core.
+    static u16 CoreIds[CPU_SETSIZE];
+
+    Topology.cpu_count = 0;
+
+    for (usize cpu_id = 0; cpu_id < CPU_SETSIZE; ++cpu_id) {
+        char path[96];
+        cpu_set_t siblings;
+        CpuInfo *info = &Topology.cpus[Topology.cpu_count];
+
+        if (!CPU_ISSET(cpu_id, process_cpus)) {
+            continue;
+        }
+
+        snprintf(
+            path,
+            sizeof(path),
+            "/sys/devices/system/cpu/cpu%zu/topology/thread_siblings_list",
+            cpu_id
+        );
+
+        // Consider the CPU as a core of its own if the kernel doesn't tell us about its siblings.
+        if (!read_id_list(path, &siblings)) {
+            CPU_ZERO(&siblings);
+            CPU_SET(cpu_id, &siblings);
+        }
+
+        CPU_AND(&siblings, &siblings, process_cpus);
+        CoreIds[cpu_id] = (u16)cpu_id;
+        info->smt_index = 0;
+
+        for (usize sibling = 0; sibling < cpu_id; ++sibling) {
+            if (CPU_ISSET(sibling, &siblings)) {
+                CoreIds[cpu_id] = (u16)usize_min(CoreIds[cpu_id], sibling);
+                ++info->smt_index;
+            }
+        }
+
+        info->cpu_id = (u16)cpu_id;
+        info->node = cpu_node(cpu_id);
+        info->core_rank = 0;
+        ++Topology.cpu_count;
+    }
+
+    // Rank the physical cores of each node by their ID.
+    for (usize i = 0; i < Topology.cpu_count; ++i) {
+        CpuInfo *info = &Topology.cpus[i];
+
+        for (usize j = 0; j < Topology.cpu_count; ++j) {
+            const CpuInfo *other = &Topology.cpus[j];
+
+            if (other->smt_index == 0 && other->node == info->node
+                && other->cpu_id < CoreIds[info->cpu_id]) {
+                ++info->core_rank;
+            }
+        }
+    }
+}
+
+static int compare_cpus_compact(const void *lhs_ptr, const void *rhs_ptr) {
+    const CpuInfo *lhs = (const CpuInfo *)lhs_ptr;
+    const CpuInfo *rhs = (const CpuInfo *)rhs_ptr;
+
+    if (lhs->node != rhs->node) {
+        return (int)lhs->node - (int)rhs->node;
+    }
+
+    if (lhs->core_rank != rhs->core_rank) {
+        return (int)lhs->core_rank - (int)rhs->core_rank;
+    }
+
+    return (int)lhs->smt_index - (int)rhs->smt_index;
+}
+
+static int compare_cpus_scatter(const void *lhs_ptr, const void *rhs_ptr) {
+    const CpuInfo *lhs = (const CpuInfo *)lhs_ptr;
+    const CpuInfo *rhs = (const CpuInfo *)rhs_ptr;
+
+    if (lhs->smt_index != rhs->smt_index) {
+        return (int)lhs->smt_index - (int)rhs->smt_index;
+    }
+
+    if (lhs->core_rank != rhs->core_rank) {
+        return (int)lhs->core_rank - (int)rhs->core_rank;
+    }
+
+    return (int)lhs->node - (int)rhs->node;
+}
+
+static void numa_mbind(void *ptr, usize size, int mode, const unsigned long *nodemask) {
+    const usize page_size = (usize)sysconf(_SC_PAGESIZE);
+    const usize begin = usize_next_multiple_of((usize)ptr, page_size);
+    const usize end = ((usize)ptr + size) / page_size * page_size;
+
+    // Only whole pages can have a memory policy, so we skip the partial pages at both ends of the
+    // range. Failures are silently ignored, since this is only a performance hint.
+    if (begin < end) {
+        syscall(
+            SYS_mbind,
+            (void *)begin,
+            (unsigned long)(end - begin),
+            mode,
+            nodemask,
+            (unsigned long)NUMA_MAX_NODES + 1,
+            0
+        );
+    }
+}
+#endif
+
+void numa_init(void) {
+    atomic_init(&NumaEnabled, true);
+    Topology.node_count = 1;
+
+#if defined(__linux__)
+    cpu_set_t process_cpus;
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &process_cpus)) {
+        return;
+    }
+
+    if (!numa_init_nodes(&process_cpus)) {
+        Topology.node_count = 1;
+    }
+
+    numa_init_cpus(&process_cpus);
+#endif
+}
+
+void numa_set_enabled(bool state) {
+    atomic_store_explicit(&NumaEnabled, state, memory_order_relaxed);
+}
+
+bool numa_is_active(void) {
+    return Topology.node_count > 1 && atomic_load_explicit(&NumaEnabled, memory_order_relaxed);
+}
+
+usize numa_node_count(void) {
+    return Topology.node_count;
+}
+
+usize numa_cpu_count(void) {
+#if defined(__linux__)
+    return usize_max(Topology.cpu_count, 1);
+#else
+    return 1;
+#endif
+}
+
+bool numa_set_thread_binding(ThreadBinding binding, StringView cpu_list) {
+#if defined(__linux__)
+    CpuInfo ordered[CPU_SETSIZE];
+    cpu_set_t list_cpus;
+    usize count = 0;
+
+    BindingCpuCount = 0;
+
+    if (binding == ThreadBindingNone) {
+        return true;
+    }
+
+    if (binding == ThreadBindingList && !parse_id_list(cpu_list, &list_cpus)) {
+        return false;
+    }
+
+    for (usize i = 0; i < Topology.cpu_count; ++i) {
+        const CpuInfo *info = &Topology.cpus[i];
+
+        if ((binding == ThreadBindingNoSmt && info->smt_index != 0)
+            || (binding == ThreadBindingList && !CPU_ISSET(info->cpu_id, &list_cpus))) {
+            continue;
+        }
+
+        ordered[count++] = *info;
+    }
+
+    if (binding == ThreadBindingCompact || binding == ThreadBindingNoSmt) {
+        qsort(ordered, count, sizeof(CpuInfo), compare_cpus_compact);
+    } else if (binding == ThreadBindingScatter) {
+        qsort(ordered, count, sizeof(CpuInfo), compare_cpus_scatter);
+    }
+
+    for (usize i = 0; i < count; ++i) {
+        BindingCpus[i] = ordered[i].cpu_id;
+    }
+
+    BindingCpuCount = count;
+    return count != 0;
+#else
+    (void)cpu_list;
+    return binding != ThreadBindingList;
+#endif
+}
+
+usize numa_worker_node(usize worker_index) {
+    if (!numa_is_active()) {
+        return 0;
+    }
+
+#if defined(__linux__)
+    // Pinned workers use the node of their CPU.
+    if (BindingCpuCount != 0) {
+        return cpu_node(BindingCpus[worker_index % BindingCpuCount]);
+    }
+#endif
+
+    // Spread workers evenly across nodes so that all memory controllers get used.
+    return worker_index % Topology.node_count;
+}
+
+void numa_bind_worker_thread(usize worker_index) {
+#if defined(__linux__)
+    if (BindingCpuCount != 0) {
+        cpu_set_t cpu;
+
+        // Wrap around if there are more workers than CPUs to pin them to.
+        CPU_ZERO(&cpu);
+        CPU_SET(BindingCpus[worker_index % BindingCpuCount], &cpu);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu);
+    } else if (numa_is_active()) {
+        pthread_setaffinity_np(
+            pthread_self(),
+            sizeof(cpu_set_t),
+            &Topology.node_cpus[numa_worker_node(worker_index)]
+        );
+    }
+#else
+    (void)worker_index;
+#endif
+}
+
+void numa_bind_memory(void *ptr, usize size, usize node) {
+#if defined(__linux__)
+    if (numa_is_active()) {
+        unsigned long nodemask[NUMA_MASK_WORDS] = {0};
+        const usize node_id = Topology.node_ids[node];
+
+        nodemask[node_id / 64] |= 1ul << (node_id % 64);
+        numa_mbind(ptr, size, NUMA_MPOL_PREFERRED, nodemask);
+    }
+#else
+    (void)ptr;
+    (void)size;
+    (void)node;
+#endif
+}
+
+void numa_interleave_memory(void *ptr, usize size) {
+#if defined(__linux__)
+    if (numa_is_active()) {
+        unsigned long nodemask[NUMA_MASK_WORDS] = {0};
+
+        for (usize i = 0; i < Topology.node_count; ++i) {
+            nodemask[Topology.node_ids[i] / 64] |= 1ul << (Topology.node_ids[i] % 64);
+        }
+
+        numa_mbind(ptr, size, NUMA_MPOL_INTERLEAVE, nodemask);
+    }
+#else
+    (void)ptr;
+    (void)size;
+#endif
+}
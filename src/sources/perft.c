@@ -0,0 +1,97 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "perft.h"
+
+#include <string.h>
+
+#include "movelist.h"
+#include "wmalloc.h"
+
+// Mixes the depth into the position key, so that counts of the same position at different depths
+// use distinct entries.
+static Key perft_key(Key key, u16 depth) {
+    return key ^ ((u64)depth * 0x9E3779B97F4A7C15ull);
+}
+
+void perft_table_init(PerftTable *perft_table) {
+    perft_table->entry_count = 0;
+    perft_table->table = NULL;
+}
+
+void perft_table_destroy(PerftTable *perft_table) {
+    wrap_aligned_free(perft_table->table);
+    perft_table_init(perft_table);
+}
+
+void perft_table_resize(PerftTable *perft_table, usize size_mb) {
+    perft_table_destroy(perft_table);
+
+    if (size_mb == 0) {
+        return;
+    }
+
+    perft_table->entry_count = size_mb * 1024 * 1024 / sizeof(PerftEntry);
+    perft_table->table = wrap_aligned_alloc(64, perft_table->entry_count * sizeof(PerftEntry));
+    memset(perft_table->table, 0, perft_table->entry_count * sizeof(PerftEntry));
+}
+
+u64 perft(Board *board, u16 depth, PerftTable *perft_table) {
+    Movelist list;
+    Boardstack stack;
+    PerftEntry *entry = NULL;
+    Key key = 0;
+    u64 total;
+
+    if (depth == 0) {
+        return 1;
+    }
+
+    movelist_generate_legal(&list, board);
+
+    // Count leaves in bulk at the last ply, which is cheaper than probing the table.
+    if (depth == 1) {
+        return movelist_size(&list);
+    }
+
+    if (perft_table->table != NULL) {
+        key = perft_key(board->stack->board_key, depth);
+        entry = &perft_table->table[u64_mulhi(key, perft_table->entry_count)];
+
+        const u64 count = atomic_load_explicit(&entry->count, memory_order_relaxed);
+
+        if ((atomic_load_explicit(&entry->check, memory_order_relaxed) ^ count) == key) {
+            return count;
+        }
+    }
+
+    total = 0;
+
+    for (const Move *extmove = movelist_begin(&list); extmove < movelist_end(&list); ++extmove) {
+        board_do_move(board, *extmove, &stack);
+        total += perft(board, depth - 1, perft_table);
+        board_undo_move(board, *extmove);
+    }
+
+    if (entry != NULL) {
+        atomic_store_explicit(&entry->check, key ^ total, memory_order_relaxed);
+        atomic_store_explicit(&entry->count, total, memory_order_relaxed);
+    }
+
+    return total;
+}
@@ -95,33 +95,116 @@ static i16 get_corrhist_total_score(const Board *board, const Worker *worker) {
         );
 }
 
-static u64 perft(Board *board, u16 depth) {
-    Movelist list;
-    Boardstack stack;
-    u64 total;
+// Probes the TT for the given position. Entries only store a fragment of their key, so an entry
+// whose move isn't even pseudo-legal here belongs to another position, and is reported as a miss.
+// The entry is also marked as empty, since the next save for this position would otherwise see a
+// matching key fragment, and keep the foreign move or the foreign deeper data.
+static TranspositionEntry *tt_probe_checked(
+    TranspositionTable *tt,
+    TtStats *stats,
+    const Board *board,
+    Key key,
+    bool *found
+) {
+    TranspositionEntry *tt_entry = tt_probe(tt, stats, key, found);
 
-    if (depth == 0) {
-        return 1;
+    if (*found && tt_entry->bestmove != NO_MOVE
+        && !board_move_is_pseudolegal(board, tt_entry->bestmove)) {
+        tt_stats_inc(stats, collisions);
+        tt_entry->depth = 0;
+        *found = false;
     }
 
-    movelist_generate_legal(&list, board);
+    return tt_entry;
+}
+
+// Returns the raw static eval of the position, looking it up in the worker's eval cache first.
+// The window is only used by the lazy evaluation, and is given in raw eval units. `exact` is set to
+// false if the lazy evaluation returned a partial eval.
+static Score
+    cached_evaluate(Worker *worker, const Board *board, Score alpha, Score beta, bool *exact) {
+    const Key key = board->stack->board_key;
+    Score raw_eval;
+
+    *exact = true;
+
+    const bool cache_hit = eval_cache_probe(&worker->eval_cache, key, &raw_eval);
+
+    search_stats_inc_if(worker, eval_cache_probes, worker->eval_cache.entry_count != 0);
+    search_stats_inc_if(worker, eval_cache_hits, cache_hit);
+
+    if (!cache_hit) {
+        raw_eval = evaluate_in_window(board, alpha, beta, exact);
+        search_stats_inc(worker, evaluations);
+        search_stats_inc_if(worker, lazy_evaluations, !*exact);
+
+        // Partial evals depend on the window, so keep them out of the cache.
+        if (*exact) {
+            eval_cache_store(&worker->eval_cache, key, raw_eval);
+        }
+    }
+
+    return raw_eval;
+}
+
+// Counts the leaf nodes of the root moves handed out to this worker during a perft run
+static void worker_perft(Worker *worker) {
+    WorkerPool *wpool = worker->pool;
+    const u16 depth = wpool->search_params.perft;
+    Board *board = &worker->board;
+    Boardstack stack;
+
+    while (true) {
+        const usize index =
+            atomic_fetch_add_explicit(&wpool->perft_next_root, 1, memory_order_relaxed);
+
+        if (index >= worker->root_move_count) {
+            break;
+        }
+
+        const Move move = worker->root_moves[index].move;
 
-    if (depth == 1) {
-        return movelist_size(&list);
+        board_do_move(board, move, &stack);
+        wpool->perft_counts[index] = perft(board, depth - 1, &wpool->perft_table);
+        board_undo_move(board, move);
     }
+}
 
-    total = 0;
+// Runs a perft over the whole pool, with the root moves split between the workers
+static void main_worker_perft(Worker *worker) {
+    WorkerPool *wpool = worker->pool;
+    const Timepoint start = timepoint_now();
+    u64 nodes = 0;
 
-    for (const Move *extmove = movelist_begin(&list); extmove < movelist_end(&list); ++extmove) {
-        board_do_move(board, *extmove, &stack);
-        total += perft(board, depth - 1);
-        board_undo_move(board, *extmove);
+    atomic_store_explicit(&wpool->perft_next_root, 0, memory_order_relaxed);
+    wpool_start_aux_workers(wpool);
+    worker_perft(worker);
+    wpool_wait_aux_workers(wpool);
+
+    const Duration elapsed = timepoint_diff(start, timepoint_now());
+
+    sync_lock_stdout();
+
+    for (usize i = 0; i < worker->root_move_count; ++i) {
+        nodes += wpool->perft_counts[i];
+
+        if (wpool->search_params.divide) {
+            fwrite_strview(stdout, board_move_to_uci(&worker->board, worker->root_moves[i].move));
+            printf(": " FORMAT_LARGE_INT "\n", (LargeInt)wpool->perft_counts[i]);
+        }
     }
 
-    return total;
+    printf(
+        "info nodes " FORMAT_LARGE_INT " nps " FORMAT_LARGE_INT " time " FORMAT_LARGE_INT "\n",
+        (LargeInt)nodes,
+        (LargeInt)compute_nps(nodes, elapsed),
+        (LargeInt)elapsed
+    );
+    fflush(stdout);
+    sync_unlock_stdout();
 }
 
-static void info_append_score(String *info_str, Score score, bool normalize) {
+void info_append_score(String *info_str, Score score, bool normalize) {
     if (normalize) {
         score = normalized_score(score);
     }
@@ -244,23 +327,16 @@ void main_worker_search(Worker *worker) {
     worker_init_search_data(worker);
 
     if (search_params->perft != 0) {
-        const Timepoint start = timepoint_now();
-        const u64 nodes = perft(board, search_params->perft);
-        const Duration elapsed = timepoint_diff(start, timepoint_now());
-
-        printf(
-            "info nodes " FORMAT_LARGE_INT " nps " FORMAT_LARGE_INT " time " FORMAT_LARGE_INT "\n",
-            (LargeInt)nodes,
-            (LargeInt)compute_nps(nodes, elapsed),
-            (LargeInt)elapsed
-        );
+        main_worker_perft(worker);
         goto cleanup;
     }
 
     // Stop the search here if there exists no legal moves due to checkmate/stalemate.
     if (movelist_size(&search_params->searchmoves) == 0) {
-        printf("info depth 1 score %s 0\n", board->stack->checkers ? "mate" : "cp");
-        fflush(stdout);
+        if (!search_params->silent) {
+            printf("info depth 1 score %s 0\n", board->stack->checkers ? "mate" : "cp");
+            fflush(stdout);
+        }
     } else {
         wpool_init_new_search(worker->pool);
 
@@ -278,24 +354,43 @@ void main_worker_search(Worker *worker) {
 
     // The UCI protocol specifies that we shouldn't send the `bestmove` command before the GUI sends
     // us the `stop` in infinite mode or `ponderhit` in ponder mode.
-    while (!wpool_is_stopped(worker->pool)
-           && (wpool_is_pondering(worker->pool) || search_params->infinite))
-        ;
+    wpool_wait_search_release(worker->pool, search_params->infinite);
 
     wpool_stop(worker->pool);
 
     // We don't need to wait for auxiliary threads when we have no root moves since we never wake
     // them up.
     if (movelist_size(&search_params->searchmoves) == 0) {
-        sync_lock_stdout();
-        puts("bestmove 0000");
-        fflush(stdout);
-        sync_unlock_stdout();
+        if (!search_params->silent) {
+            sync_lock_stdout();
+            puts("bestmove 0000");
+            fflush(stdout);
+            sync_unlock_stdout();
+        }
+
         goto cleanup;
     }
 
     wpool_wait_aux_workers(worker->pool);
 
+    if (search_params->silent) {
+        goto cleanup;
+    }
+
+#ifdef TT_STATS
+    TtStats tt_stats;
+
+    wpool_get_tt_stats(worker->pool, &tt_stats);
+    tt_show_stats(&worker->pool->tt, &tt_stats);
+#endif
+
+#ifdef SEARCH_STATS
+    SearchStats search_stats;
+
+    wpool_get_search_stats(worker->pool, &search_stats);
+    search_stats_show(&search_stats);
+#endif
+
     sync_lock_stdout();
     fwrite_strview(stdout, STATIC_STRVIEW("bestmove "));
     fwrite_strview(stdout, board_move_to_uci(board, worker->root_moves->move));
@@ -310,7 +405,12 @@ void main_worker_search(Worker *worker) {
         bool found;
 
         board_do_move(board, worker->root_moves->move, &stack);
-        tt_entry = tt_probe(&worker->pool->tt, board->stack->board_key, &found);
+        tt_entry = tt_probe(
+            &worker->pool->tt,
+            worker_tt_stats(worker, &worker->pool->tt),
+            board->stack->board_key,
+            &found
+        );
         board_undo_move(board, worker->root_moves->move);
 
         if (found) {
@@ -347,6 +447,13 @@ void worker_search(Worker *worker) {
         worker_init_search_data(worker);
     }
 
+    // Auxiliary workers only count leaf nodes for their share of the root moves in perft runs.
+    if (search_params->perft != 0) {
+        worker_perft(worker);
+        boardstack_destroy(worker->board.stack);
+        return;
+    }
+
     // Clamp MultiPV to the maximal number of available root moves.
     const u16 multi_pv = (u16)u64_min((u64)search_params->multi_pv, (u64)worker->root_move_count);
     Searchstack sstack[256];
@@ -370,7 +477,16 @@ void worker_search(Worker *worker) {
             break;
         }
 
+        // Keep track of the last fully searched iteration, since root move scores are unreliable
+        // after an interrupted one.
+        worker->completed_depth = worker->root_depth;
+        worker->completed_score = worker->root_moves->previous_score;
+
         if (worker->thread_index == 0) {
+            const Timepoint now = timepoint_now();
+
+            worker->depth_times[worker->root_depth] =
+                timepoint_diff(worker->pool->timeman.start, now);
             timeman_update(
                 &worker->pool->timeman,
                 &worker->board,
@@ -380,7 +496,7 @@ void worker_search(Worker *worker) {
 
             // If we went over optimal time usage, we just finished our iteration, so we can safely
             // stop search.
-            if (timeman_can_stop_search(&worker->pool->timeman, worker->pool, timepoint_now())) {
+            if (timeman_can_stop_search(&worker->pool->timeman, worker->pool, now)) {
                 break;
             }
         }
@@ -398,6 +514,9 @@ void worker_search(Worker *worker) {
         }
     }
 
+    // Publish the final node count, so that the search report can be exact.
+    worker_publish_nodes(worker);
+
     // Be careful to not destroy the main worker's board here since we still need it.
     if (worker->thread_index != 0) {
         boardstack_destroy(worker->board.stack);
@@ -412,7 +531,13 @@ void use_emergency_scoring(Worker *worker, Searchstack *ss) {
     Move currmove;
     Score score = NO_SCORE;
     Move tt_move = NO_MOVE;
-    TranspositionEntry *tt_entry = tt_probe(&worker->pool->tt, board->stack->board_key, &found);
+    TranspositionEntry *tt_entry = tt_probe_checked(
+        &worker->pool->tt,
+        worker_tt_stats(worker, &worker->pool->tt),
+        board,
+        board->stack->board_key,
+        &found
+    );
 
     if (found) {
         score = score_from_tt(tt_entry->score, 0);
@@ -493,7 +618,7 @@ bool worker_search_pv_line(Worker *worker, u16 depth, u16 multi_pv, Searchstack
             use_emergency_scoring(worker, ss + 4);
         }
 
-        if (worker->thread_index == 0) {
+        if (worker->thread_index == 0 && !worker->pool->search_params.silent) {
             Duration elapsed = timepoint_diff(worker->pool->timeman.start, timepoint_now());
             const bool late_info = elapsed > 3000;
             const bool single_pv = multi_pv == 1;
@@ -534,6 +659,28 @@ bool worker_search_pv_line(Worker *worker, u16 depth, u16 multi_pv, Searchstack
     return !wpool_is_stopped(worker->pool);
 }
 
+// Prefetches the TT cluster of the position reached after the given move, so that its memory
+// latency overlaps with the pruning checks and the move execution. Returns the hashkey of the
+// child position.
+static Key prefetch_child_tt_cluster(const Board *board, Move move, TranspositionTable *tt) {
+    const Key board_key = board_key_after(board, move);
+
+    prefetch(tt_cluster_at(tt, board_key));
+    return board_key;
+}
+
+// Prefetches the King-Pawn entry of the position reached by the last move. This is done once the
+// move is made rather than along with the TT entry, so that moves pruned before being played don't
+// pull in entries that will never be probed.
+static void prefetch_king_pawn_entry(Worker *worker, const Board *board) {
+    const Key king_pawn_key = board->stack->king_pawn_key;
+
+    // The King-Pawn entry only changes for King and pawn moves, and pawn captures.
+    if (king_pawn_key != board->stack->previous->king_pawn_key) {
+        prefetch(king_pawn_entry_at(&worker->king_pawn_table, king_pawn_key));
+    }
+}
+
 Score search(
     bool pv_node,
     Board *board,
@@ -564,6 +711,8 @@ Score search(
     Movepicker mp;
     Score best_score = -INF_SCORE;
 
+    search_stats_inc(worker, search_nodes);
+
     // Verify the time usage if we're the main thread.
     if (worker->thread_index == 0) {
         wpool_check_time(worker->pool);
@@ -595,6 +744,7 @@ Score search(
     }
 
     TranspositionEntry *tt_entry;
+    TtStats *tt_stats = worker_tt_stats(worker, &worker->pool->tt);
     Score tt_score = NO_SCORE;
     Move tt_move = NO_MOVE;
     i16 tt_depth = 0;
@@ -604,14 +754,15 @@ Score search(
     Key key = board->stack->board_key ^ ((Key)ss->excluded_move << 16);
     Score raw_eval;
     Score eval;
+    bool exact_eval = true;
 
     // Probe the TT for information on the current position.
-    tt_entry = tt_probe(&worker->pool->tt, key, &tt_found);
+    tt_entry = tt_probe_checked(&worker->pool->tt, tt_stats, board, key, &tt_found);
 
     if (tt_found) {
         tt_score = score_from_tt(tt_entry->score, ss->plies);
         tt_move = tt_entry->bestmove;
-        tt_depth = tt_entry->depth;
+        tt_depth = tt_entry_depth(tt_entry);
         tt_bound = tt_entry_bound(tt_entry);
 
         // Check if we can directly return a score for non-PV nodes.
@@ -622,6 +773,8 @@ Score search(
                 update_quiet_history(board, depth, tt_move, NULL, 0, ss);
             }
 
+            tt_stats_inc(tt_stats, cutoffs);
+            search_stats_inc(worker, tt_cutoffs);
             return tt_score;
         }
 
@@ -641,7 +794,7 @@ Score search(
         goto main_loop;
     }
     // Use the TT stored information for getting an eval.
-    else if (tt_found) {
+    else if (tt_found && tt_entry->eval != NO_SCORE) {
         raw_eval = tt_entry->eval;
         eval = ss->static_eval = raw_eval + get_corrhist_total_score(board, worker);
 
@@ -652,11 +805,22 @@ Score search(
     }
     // Call the evaluation function otherwise.
     else {
-        raw_eval = evaluate(board);
-        eval = ss->static_eval = raw_eval + get_corrhist_total_score(board, worker);
+        const i16 correction = get_corrhist_total_score(board, worker);
+
+        raw_eval = cached_evaluate(
+            worker,
+            board,
+            alpha - correction,
+            beta - correction,
+            &exact_eval
+        );
+        eval = ss->static_eval = raw_eval + correction;
 
-        // Save the eval in TT so that other workers won't have to recompute it.
-        tt_save(&worker->pool->tt, tt_entry, key, NO_SCORE, raw_eval, 0, NO_BOUND, NO_MOVE);
+        // The eval cache keeps exact evals until the node saves its result in TT. Partial evals
+        // depend on the window, so they never reach the TT.
+        if (!exact_eval) {
+            raw_eval = NO_SCORE;
+        }
     }
 
     improving = ss->plies >= 2 && ss->static_eval > (ss - 2)->static_eval;
@@ -670,12 +834,14 @@ Score search(
     // Razoring. If our static eval isn't good, and depth is low, it is likely that only a capture
     // will save us at this stage. Drop into qsearch.
     if (!pv_node && depth == 1 && ss->static_eval + 144 <= alpha) {
+        search_stats_inc(worker, razoring);
         return qsearch(false, board, alpha, beta, ss);
     }
 
     // Futility Pruning. If our eval is quite good and depth is low, we just assume that we won't
     // fall far behind in the next plies, and we return the eval.
     if (!pv_node && depth <= 7 && eval - 86 * depth + 79 * improving >= beta && eval < VICTORY) {
+        search_stats_inc(worker, futility);
         return eval;
     }
 
@@ -692,11 +858,12 @@ Score search(
         // Compute the depth reduction based on depth and eval difference with beta.
         i16 r = (855 + 61 * depth) / 256 + i16_min((eval - beta) / 111, 5);
 
+        search_stats_inc(worker, nmp_tries);
         ss->current_move = NULL_MOVE;
         ss->piece_history = (ss - 2)->piece_history;
 
         board_do_null_move(board, &stack);
-        prefetch(tt_entry_at(&worker->pool->tt, board->stack->board_key));
+        prefetch(tt_cluster_at(&worker->pool->tt, board->stack->board_key));
         worker_increment_nodes(worker);
 
         // Perform the reduced search.
@@ -713,6 +880,7 @@ Score search(
             // Do not trust win claims for the same reason as above, and do not return early for
             // high-depth searches.
             if (worker->nmp_verif_plies != 0 || (depth <= 12 && i16_abs(beta) < VICTORY)) {
+                search_stats_inc(worker, nmp_cutoffs);
                 return score;
             }
 
@@ -720,11 +888,14 @@ Score search(
             // same depth, but this time with NMP disabled for a few plies. If this search still
             // beats beta, we assume to not be in a zugzwang situation, and return the previous
             // reduced search score.
+            search_stats_inc(worker, nmp_verifications);
             worker->nmp_verif_plies = ss->plies + (depth - r) * 3 / 4;
             verif_score = search(false, board, depth - r, beta - 1, beta, ss, false);
             worker->nmp_verif_plies = 0;
 
             if (verif_score >= beta) {
+                search_stats_inc(worker, nmp_verified);
+                search_stats_inc(worker, nmp_cutoffs);
                 return score;
             }
         }
@@ -740,6 +911,8 @@ Score search(
         Move currmove;
         Boardstack stack;
 
+        search_stats_inc(worker, probcut_tries);
+
         movepicker_init(
             &mp,
             true,
@@ -758,18 +931,20 @@ Score search(
                 continue;
             }
 
+            prefetch_child_tt_cluster(board, currmove, &worker->pool->tt);
             ss->current_move = currmove;
             ss->piece_history =
                 &worker->continuation_hist
                      ->piece_history[board_piece_on(board, move_from(currmove))][move_to(currmove)];
 
             board_do_move(board, currmove, &stack);
-            prefetch(tt_entry_at(&worker->pool->tt, board->stack->board_key));
+            prefetch_king_pawn_entry(worker, board);
             worker_increment_nodes(worker);
 
             Score probcut_score = -qsearch(false, board, -probcut_beta, -probcut_beta + 1, ss + 1);
 
             if (probcut_score >= probcut_beta) {
+                search_stats_inc(worker, probcut_searches);
                 probcut_score = -search(
                     false,
                     board,
@@ -786,6 +961,7 @@ Score search(
             if (probcut_score >= probcut_beta) {
                 tt_save(
                     &worker->pool->tt,
+                    tt_stats,
                     tt_entry,
                     key,
                     score_to_tt(probcut_score, ss->plies),
@@ -794,6 +970,7 @@ Score search(
                     LOWER_BOUND,
                     currmove
                 );
+                search_stats_inc(worker, probcut_cutoffs);
                 return probcut_score;
             }
         }
@@ -833,6 +1010,13 @@ main_loop:
         }
 
         ++move_count;
+        const Key child_key = prefetch_child_tt_cluster(board, currmove, &worker->pool->tt);
+
+        // Children of low-depth nodes are likely to drop into qsearch, so also prefetch their
+        // entry from the qsearch cache if we have one.
+        if (depth <= 3 && worker->qcache.table != NULL) {
+            prefetch(tt_cluster_at(&worker->qcache, child_key));
+        }
 
         const bool is_quiet = !board_move_is_noisy(board, currmove);
 
@@ -840,12 +1024,14 @@ main_loop:
             // Late Move Pruning. For low-depth nodes, stop searching quiets after a certain
             // movecount has been reached.
             if (depth <= 10 && move_count >= lmp_threshold(depth, improving)) {
+                search_stats_inc_if(worker, lmp, !skip_quiets);
                 skip_quiets = true;
             }
 
             // Futility Pruning. For low-depth nodes, stop searching quiets if the eval suggests
             // that only captures will save the day.
             if (depth <= 5 && !in_check && is_quiet && eval + 186 + 66 * depth <= alpha) {
+                search_stats_inc_if(worker, move_futility, !skip_quiets);
                 skip_quiets = true;
             }
 
@@ -853,6 +1039,7 @@ main_loop:
             // be bad continuations to the previous moves.
             if (depth <= 4
                 && get_conthist_move_score(board, ss, currmove) < 783 - 4872 * (depth - 1)) {
+                search_stats_inc(worker, conthist_pruning);
                 continue;
             }
 
@@ -860,6 +1047,7 @@ main_loop:
             // material to be interesting.
             if (depth <= 12
                 && !board_see_above(board, currmove, (is_quiet ? -48 * depth : -60 * depth))) {
+                search_stats_inc(worker, see_pruning);
                 continue;
             }
         }
@@ -891,6 +1079,7 @@ main_loop:
                 Score singular_score;
 
                 // Exclude the TT move from the singular search.
+                search_stats_inc(worker, singular_searches);
                 ss->excluded_move = tt_move;
                 singular_score = search(
                     false,
@@ -909,14 +1098,18 @@ main_loop:
                         && ss->double_extensions <= 10) {
                         extension = 2 + (!tt_noisy && singular_beta - singular_score > 120);
                         ++ss->double_extensions;
+                        search_stats_inc(worker, double_extensions);
                     } else {
                         extension = 1;
                     }
+
+                    search_stats_inc(worker, singular_extensions);
                 }
                 // Multicut Pruning. If our singular search produced a cutoff, and the search bounds
                 // were equal or superior to our normal search, assume that there are multiple moves
                 // that beat beta in the current node, and return a search score early.
                 else if (singular_beta >= beta) {
+                    search_stats_inc(worker, multicut);
                     return singular_beta;
                 }
                 // Negative Extensions. If our singular search produced a cutoff, with singularBeta
@@ -924,11 +1117,13 @@ main_loop:
                 // assume that searching the TT move at full depth is futile as we should get a
                 // fail-high deeper on this branch, and reduce its search depth.
                 else if (tt_score >= beta) {
+                    search_stats_inc(worker, negative_extensions);
                     extension = -1;
                 }
             }
             // Check Extensions. Extend non-LMR searches by one ply for moves that give check.
             else if (gives_check) {
+                search_stats_inc(worker, check_extensions);
                 extension = 1;
             }
         }
@@ -940,8 +1135,9 @@ main_loop:
             &worker->continuation_hist->piece_history[moved_piece][move_to(currmove)];
 
         board_do_move_gc(board, currmove, &stack, gives_check);
-        prefetch(tt_entry_at(&worker->pool->tt, board->stack->board_key));
+        prefetch_king_pawn_entry(worker, board);
         worker_increment_nodes(worker);
+        search_stats_inc(worker, searched_moves);
 
         // Late Move Reductions. For nodes not too close to qsearch (since we can't reduce their
         // search depth), we start reducing moves after a certain movecount has been reached, as we
@@ -972,10 +1168,12 @@ main_loop:
             // immediately into qsearch.
             r = i16_clamp(r, 0, new_depth - 1);
 
+            search_stats_inc(worker, lmr_searches);
             score = -search(false, board, new_depth - r, -alpha - 1, -alpha, ss + 1, true);
 
             // Perform another search at full depth if LMR failed high.
             if (r != 0 && score > alpha) {
+                search_stats_inc(worker, lmr_researches);
                 score = -search(
                     false,
                     board,
@@ -1079,7 +1277,8 @@ main_loop:
 
     // If we're not in check, and we don't have a tactical best-move, and the static eval needs
     // moving in a direction, then update corrhist.
-    if (!(in_check || (bestmove && board_move_is_noisy(board, bestmove))
+    // Partial evals are skipped, since their error doesn't come from the evaluation itself.
+    if (!(in_check || !exact_eval || (bestmove && board_move_is_noisy(board, bestmove))
           || (bound == LOWER_BOUND && best_score <= ss->static_eval)
           || (bound == UPPER_BOUND && best_score >= ss->static_eval))) {
         update_correction_histories(worker, board, depth, (i32)best_score - (i32)ss->static_eval);
@@ -1089,6 +1288,7 @@ main_loop:
     if (!root_node || worker->pv_line == 0) {
         tt_save(
             &worker->pool->tt,
+            tt_stats,
             tt_entry,
             key,
             score_to_tt(best_score, ss->plies),
@@ -1107,6 +1307,8 @@ Score qsearch(bool pv_node, Board *board, Score alpha, Score beta, Searchstack *
     const Score old_alpha = alpha;
     Movepicker mp;
 
+    search_stats_inc(worker, qsearch_nodes);
+
     // Verify the time usage if we're the main thread.
     if (worker->thread_index == 0) {
         wpool_check_time(worker->pool);
@@ -1140,8 +1342,12 @@ Score qsearch(bool pv_node, Board *board, Score alpha, Score beta, Searchstack *
     Move tt_move = NO_MOVE;
     bool tt_found;
     TranspositionEntry *tt_entry;
+    TranspositionTable *tt = worker_qsearch_table(worker);
+    TtStats *tt_stats = worker_tt_stats(worker, tt);
 
-    tt_entry = tt_probe(&worker->pool->tt, board->stack->board_key, &tt_found);
+    tt_entry = tt_probe_checked(tt, tt_stats, board, board->stack->board_key, &tt_found);
+    search_stats_inc(worker, qsearch_tt_probes);
+    search_stats_inc_if(worker, qsearch_tt_hits, tt_found);
 
     // Probe the TT for information on the current position.
     if (tt_found) {
@@ -1153,6 +1359,7 @@ Score qsearch(bool pv_node, Board *board, Score alpha, Score beta, Searchstack *
         if (!pv_node
             && (((tt_bound & LOWER_BOUND) && tt_score >= beta)
                 || ((tt_bound & UPPER_BOUND) && tt_score <= alpha))) {
+            tt_stats_inc(tt_stats, cutoffs);
             return tt_score;
         }
     }
@@ -1168,7 +1375,7 @@ Score qsearch(bool pv_node, Board *board, Score alpha, Score beta, Searchstack *
         best_score = -INF_SCORE;
     } else {
         // Use the TT stored information for getting an eval.
-        if (tt_found) {
+        if (tt_found && tt_entry->eval != NO_SCORE) {
             raw_eval = tt_entry->eval;
             eval = best_score = raw_eval + get_corrhist_total_score(board, worker);
 
@@ -1179,8 +1386,22 @@ Score qsearch(bool pv_node, Board *board, Score alpha, Score beta, Searchstack *
         }
         // Call the evaluation function otherwise.
         else {
-            raw_eval = evaluate(board);
-            eval = best_score = raw_eval + get_corrhist_total_score(board, worker);
+            const i16 correction = get_corrhist_total_score(board, worker);
+            bool exact_eval;
+
+            raw_eval = cached_evaluate(
+                worker,
+                board,
+                alpha - correction,
+                beta - correction,
+                &exact_eval
+            );
+            eval = best_score = raw_eval + correction;
+
+            // Partial evals depend on the window, so don't store them in the TT.
+            if (!exact_eval) {
+                raw_eval = NO_SCORE;
+            }
         }
 
         // Stand Pat. If not playing a capture is better because of better quiet moves, allow for a
@@ -1188,10 +1409,13 @@ Score qsearch(bool pv_node, Board *board, Score alpha, Score beta, Searchstack *
         alpha = (Score)i16_max(alpha, best_score);
 
         if (alpha >= beta) {
+            search_stats_inc(worker, qsearch_stand_pats);
+
             // Save the eval in TT so that other workers won't have to recompute it.
             if (!tt_found) {
                 tt_save(
-                    &worker->pool->tt,
+                    tt,
+                    tt_stats,
                     tt_entry,
                     board->stack->board_key,
                     score_to_tt(best_score, ss->plies),
@@ -1228,6 +1452,7 @@ Score qsearch(bool pv_node, Board *board, Score alpha, Score beta, Searchstack *
         }
 
         ++move_count;
+        prefetch_child_tt_cluster(board, currmove, tt);
 
         const bool gives_check = board_move_gives_check(board, currmove);
 
@@ -1241,12 +1466,14 @@ Score qsearch(bool pv_node, Board *board, Score alpha, Score beta, Searchstack *
             // Check if the move is unlikely to improve alpha.
             if (futility_value < alpha) {
                 best_score = i16_max(best_score, futility_value);
+                search_stats_inc(worker, qsearch_futility);
                 continue;
             }
 
             // If static eval is far below alpha, only search moves that win material.
             if (futility_base < alpha && !board_see_above(board, currmove, 1)) {
                 best_score = i16_max(best_score, futility_base);
+                search_stats_inc(worker, qsearch_see_pruning);
                 continue;
             }
         }
@@ -1263,7 +1490,7 @@ Score qsearch(bool pv_node, Board *board, Score alpha, Score beta, Searchstack *
         }
 
         board_do_move_gc(board, currmove, &stack, gives_check);
-        prefetch(tt_entry_at(&worker->pool->tt, board->stack->board_key));
+        prefetch_king_pawn_entry(worker, board);
         worker_increment_nodes(worker);
 
         Score score = -qsearch(pv_node, board, -beta, -alpha, ss + 1);
@@ -1305,7 +1532,8 @@ Score qsearch(bool pv_node, Board *board, Score alpha, Score beta, Searchstack *
                                        : EXACT_BOUND;
 
     tt_save(
-        &worker->pool->tt,
+        tt,
+        tt_stats,
         tt_entry,
         board->stack->board_key,
         score_to_tt(best_score, ss->plies),
@@ -49,8 +49,10 @@ void search_params_init(
         .movetime = 0,
         .mate = 0,
         .perft = 0,
+        .divide = false,
         .infinite = false,
         .ponder = false,
+        .silent = false,
     };
 
     search_params->searchmoves.size = 0;
@@ -326,6 +328,10 @@ void search_params_set_from_uci(
             continue;
         }
 
+        if (try_set_bool(token, &search_params->divide, STATIC_STRVIEW("divide"))) {
+            continue;
+        }
+
         if (try_set_bool(token, &search_params->infinite, STATIC_STRVIEW("infinite"))) {
             continue;
         }
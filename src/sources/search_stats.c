@@ -0,0 +1,120 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2025 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "search_stats.h"
+
+#ifdef SEARCH_STATS
+#include <stdio.h>
+#include <string.h>
+
+#include "syncio.h"
+
+// Struct for a line of the search stats report. The proportion is given relative to the base
+// counter, which is either the number of nodes or tries of the corresponding technique.
+typedef struct {
+    const char *name;
+    usize counter;
+    usize base;
+} SearchStatsLine;
+
+#define STAT(counter) offsetof(SearchStats, counter)
+
+static const SearchStatsLine SearchStatsLines[] = {
+    {"TT cutoffs", STAT(tt_cutoffs), STAT(search_nodes)},
+    {"Razoring", STAT(razoring), STAT(search_nodes)},
+    {"Futility pruning", STAT(futility), STAT(search_nodes)},
+    {"NMP tries", STAT(nmp_tries), STAT(search_nodes)},
+    {"NMP cutoffs", STAT(nmp_cutoffs), STAT(nmp_tries)},
+    {"NMP verifications", STAT(nmp_verifications), STAT(nmp_tries)},
+    {"NMP verified", STAT(nmp_verified), STAT(nmp_verifications)},
+    {"Probcut tries", STAT(probcut_tries), STAT(search_nodes)},
+    {"Probcut searches", STAT(probcut_searches), STAT(probcut_tries)},
+    {"Probcut cutoffs", STAT(probcut_cutoffs), STAT(probcut_tries)},
+    {"Late move pruning", STAT(lmp), STAT(search_nodes)},
+    {"Move futility pruning", STAT(move_futility), STAT(search_nodes)},
+    {"Conthist pruning", STAT(conthist_pruning), STAT(searched_moves)},
+    {"SEE pruning", STAT(see_pruning), STAT(searched_moves)},
+    {"Singular searches", STAT(singular_searches), STAT(search_nodes)},
+    {"Singular extensions", STAT(singular_extensions), STAT(singular_searches)},
+    {"Double extensions", STAT(double_extensions), STAT(singular_searches)},
+    {"Multicut pruning", STAT(multicut), STAT(singular_searches)},
+    {"Negative extensions", STAT(negative_extensions), STAT(singular_searches)},
+    {"Check extensions", STAT(check_extensions), STAT(searched_moves)},
+    {"LMR searches", STAT(lmr_searches), STAT(searched_moves)},
+    {"LMR re-searches", STAT(lmr_researches), STAT(lmr_searches)},
+    {"QS stand pats", STAT(qsearch_stand_pats), STAT(qsearch_nodes)},
+    {"QS futility pruning", STAT(qsearch_futility), STAT(qsearch_nodes)},
+    {"QS SEE pruning", STAT(qsearch_see_pruning), STAT(qsearch_nodes)},
+    {"QS TT hits", STAT(qsearch_tt_hits), STAT(qsearch_tt_probes)},
+    {"Lazy evaluations", STAT(lazy_evaluations), STAT(evaluations)},
+    {"Eval cache hits", STAT(eval_cache_hits), STAT(eval_cache_probes)},
+    {"King-Pawn table hits", STAT(king_pawn_hits), STAT(king_pawn_probes)},
+};
+
+#undef STAT
+
+static u64 stat_value(const SearchStats *stats, usize offset) {
+    u64 value;
+
+    memcpy(&value, (const u8 *)stats + offset, sizeof(u64));
+    return value;
+}
+
+void search_stats_reset(SearchStats *stats) {
+    memset(stats, 0, sizeof(SearchStats));
+}
+
+void search_stats_add(SearchStats *restrict total, const SearchStats *restrict stats) {
+    u64 *total_counters = (u64 *)total;
+    const u64 *counters = (const u64 *)stats;
+
+    for (usize i = 0; i < sizeof(SearchStats) / sizeof(u64); ++i) {
+        total_counters[i] += counters[i];
+    }
+}
+
+void search_stats_show(const SearchStats *stats) {
+    const u64 total_nodes = stats->search_nodes + stats->qsearch_nodes;
+
+    sync_lock_stdout();
+    printf(
+        "info string Search stats: %" PRIu64 " main search nodes, %" PRIu64
+        " qsearch nodes (%" PRIu64 " permil of all nodes), %" PRIu64 " searched moves\n",
+        stats->search_nodes,
+        stats->qsearch_nodes,
+        total_nodes ? stats->qsearch_nodes * 1000 / total_nodes : 0,
+        stats->searched_moves
+    );
+
+    for (usize i = 0; i < sizeof(SearchStatsLines) / sizeof(SearchStatsLines[0]); ++i) {
+        const SearchStatsLine *line = &SearchStatsLines[i];
+        const u64 value = stat_value(stats, line->counter);
+        const u64 base = stat_value(stats, line->base);
+
+        printf(
+            "info string %-22s %12" PRIu64 " (%4" PRIu64 " permil)\n",
+            line->name,
+            value,
+            base ? value * 1000 / base : 0
+        );
+    }
+
+    fflush(stdout);
+    sync_unlock_stdout();
+}
+#endif
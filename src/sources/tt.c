@@ -21,9 +21,35 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "numa.h"
+#include "syncio.h"
 #include "wmalloc.h"
 
+enum {
+    // The header is padded to a full page so that the clusters can be mapped directly.
+    TT_FILE_HEADER_SIZE = 4096,
+    TT_FILE_VERSION = 2,
+};
+
+static const char TtFileMagic[8] = "StashTT";
+
+typedef struct {
+    char magic[8];
+    u32 version;
+    u32 entry_size;
+    u64 cluster_count;
+    u64 epoch;
+    u8 generation;
+} TtFileHeader;
+
 typedef struct _ResetThreadData {
     TranspositionTable *tt;
     usize cluster_begin;
@@ -34,34 +60,47 @@ typedef struct _ResetThreadData {
 void tt_init(TranspositionTable *tt) {
     tt->cluster_count = 0;
     tt->table = NULL;
+    tt->page_kind = PageKindDefault;
     tt->generation = 0;
+    tt->lazy_clear = false;
+
+    // Epoch tags of zero are never used, so that zeroed clusters always appear as stale.
+    tt->epoch = 1;
 }
 
 void tt_destroy(TranspositionTable *tt) {
-    wrap_aligned_free(tt->table);
+    if (tt->table != NULL) {
+        wrap_large_free(
+            tt->table,
+            tt->cluster_count * sizeof(TranspositionCluster),
+            tt->page_kind
+        );
+    }
 }
 
 void *tt_reset_thread_entry_point(void *data) {
     ResetThreadData *reset_thread_data = (ResetThreadData *)data;
     const TranspositionEntry empty_entry = {
-        .key = 0,
+        .key16 = 0,
+        .bestmove = NO_MOVE,
         .score = NO_SCORE,
         .eval = NO_SCORE,
         .depth = 0,
         .genbound = 0 | NO_BOUND,
-        .bestmove = NO_MOVE,
     };
 
     for (usize i = reset_thread_data->cluster_begin; i < reset_thread_data->cluster_end; ++i) {
         for (usize j = 0; j < ENTRY_CLUSTER_SIZE; ++j) {
             reset_thread_data->tt->table[i].cluster_entry[j] = empty_entry;
         }
+
+        reset_thread_data->tt->table[i].epoch_tag = tt_epoch_tag(reset_thread_data->tt);
     }
 
     return NULL;
 }
 
-void tt_init_new_game(TranspositionTable *tt, usize thread_count) {
+void tt_clear(TranspositionTable *tt, usize thread_count) {
     assert(thread_count != 0);
     ResetThreadData *thread_list = wrap_malloc(sizeof(ResetThreadData) * thread_count);
 
@@ -97,17 +136,67 @@ void tt_init_new_game(TranspositionTable *tt, usize thread_count) {
     free(thread_list);
 }
 
-TranspositionEntry *tt_probe(TranspositionTable *tt, Key key, bool *found) {
-    TranspositionEntry *cluster_start = tt_entry_at(tt, key);
+void tt_init_new_game(TranspositionTable *tt, usize thread_count) {
+    // Other processes may still be using the contents of a shared table.
+    if (tt->page_kind == PageKindShared) {
+        tt->generation = 0;
+        tt->epoch = TT_SHARED_EPOCH;
+        return;
+    }
+
+    if (!tt->lazy_clear) {
+        tt_clear(tt, thread_count);
+        return;
+    }
+
+    tt->generation = 0;
+    ++tt->epoch;
+
+    // Once the epoch tag wraps around, clusters from 2^32 games ago could be seen as valid again,
+    // so we fall back to an eager clear.
+    if (tt_epoch_tag(tt) == 0) {
+        ++tt->epoch;
+        tt_clear(tt, thread_count);
+    }
+}
+
+void tt_set_lazy_clear(TranspositionTable *tt, bool lazy_clear) {
+    tt->lazy_clear = lazy_clear;
+
+    if (tt->page_kind == PageKindShared) {
+        tt->epoch = TT_SHARED_EPOCH;
+    }
+}
+
+TranspositionEntry *tt_probe(TranspositionTable *tt, TtStats *stats, Key key, bool *found) {
+    TranspositionCluster *cluster = tt_cluster_at(tt, key);
+    TranspositionEntry *cluster_start = cluster->cluster_entry;
+    const u16 key16 = tt_key16(key);
+
+    tt_stats_inc(stats, probes);
+
+    // Lazily clear clusters that haven't been written to since the last epoch change.
+    if (tt_cluster_is_stale(tt, cluster)) {
+        tt_stats_inc(stats, stale_clusters);
+
+        for (usize i = 0; i < ENTRY_CLUSTER_SIZE; ++i) {
+            cluster_start[i].depth = 0;
+        }
+
+        cluster->epoch_tag = tt_epoch_tag(tt);
+        *found = false;
+        return cluster_start;
+    }
 
     // Try to find an entry matching the given key.
     for (usize i = 0; i < ENTRY_CLUSTER_SIZE; ++i) {
         TranspositionEntry *cur_entry = &cluster_start[i];
 
-        if (!cur_entry->key || cur_entry->key == key) {
+        if (tt_entry_is_empty(cur_entry) || cur_entry->key16 == key16) {
             // Refresh the generation counter to prevent it from being cleared.
             cur_entry->genbound = (u8)(tt->generation | (cur_entry->genbound & ~GENERATION_MASK));
-            *found = (cur_entry->key == key);
+            *found = !tt_entry_is_empty(cur_entry);
+            tt_stats_inc_if(stats, hits, *found);
 
             return cur_entry;
         }
@@ -131,6 +220,7 @@ TranspositionEntry *tt_probe(TranspositionTable *tt, Key key, bool *found) {
 
 void tt_save(
     TranspositionTable *tt,
+    TtStats *stats,
     TranspositionEntry *tt_entry,
     Key key,
     Score score,
@@ -139,16 +229,37 @@ void tt_save(
     Bound bound,
     Move bestmove
 ) {
-    if (bestmove != NO_MOVE || key != tt_entry->key) {
+    const u16 key16 = tt_key16(key);
+    const bool same_position = !tt_entry_is_empty(tt_entry) && tt_entry->key16 == key16;
+
+    if (bestmove != NO_MOVE || !same_position) {
         tt_entry->bestmove = bestmove;
     }
 
+#ifdef TT_STATS
+    if (tt_entry_is_empty(tt_entry)) {
+        tt_stats_inc(stats, replaced_empty);
+    } else if (!same_position) {
+        if ((tt_entry->genbound & GENERATION_MASK) != tt->generation) {
+            tt_stats_inc(stats, replaced_aged);
+        } else {
+            tt_stats_inc(stats, replaced_shallower);
+        }
+    } else if (bound == EXACT_BOUND || depth + 4 >= tt_entry_depth(tt_entry)) {
+        tt_stats_inc(stats, updated_same_key);
+    } else {
+        tt_stats_inc(stats, preserved_same_key);
+    }
+#else
+    (void)stats;
+#endif
+
     // Do not erase entries with high depth for the same position.
-    if (bound == EXACT_BOUND || key != tt_entry->key || depth + 4 >= (i16)tt_entry->depth) {
-        tt_entry->key = key;
+    if (bound == EXACT_BOUND || !same_position || depth + 4 >= tt_entry_depth(tt_entry)) {
+        tt_entry->key16 = key16;
         tt_entry->score = score;
         tt_entry->eval = eval;
-        tt_entry->depth = depth;
+        tt_entry->depth = (u8)(depth + TT_DEPTH_OFFSET);
         tt_entry->genbound = tt->generation | bound;
     }
 }
@@ -156,23 +267,278 @@ void tt_save(
 u16 tt_hashfull(TranspositionTable *tt) {
     u16 count = 0;
 
+    // Sample clusters evenly over the whole table, rather than only looking at its first pages.
     for (usize i = 0; i < 1000; ++i) {
+        const TranspositionCluster *cluster = &tt->table[i * tt->cluster_count / 1000];
+
+        if (tt_cluster_is_stale(tt, cluster)) {
+            continue;
+        }
+
         for (usize j = 0; j < ENTRY_CLUSTER_SIZE; ++j) {
-            count += (tt->table[i].cluster_entry[j].genbound & GENERATION_MASK) == tt->generation;
+            const TranspositionEntry *cur_entry = &cluster->cluster_entry[j];
+
+            count += !tt_entry_is_empty(cur_entry)
+                && (cur_entry->genbound & GENERATION_MASK) == tt->generation;
         }
     }
 
     return count / ENTRY_CLUSTER_SIZE;
 }
 
-void tt_resize(TranspositionTable *tt, usize size_mb, usize thread_count) {
-    if (tt->table != NULL) {
-        wrap_aligned_free(tt->table);
+#ifdef TT_STATS
+void tt_stats_reset(TtStats *stats) {
+    memset(stats, 0, sizeof(TtStats));
+}
+
+void tt_stats_add(TtStats *restrict total, const TtStats *restrict stats) {
+    u64 *total_counters = (u64 *)total;
+    const u64 *counters = (const u64 *)stats;
+
+    for (usize i = 0; i < sizeof(TtStats) / sizeof(u64); ++i) {
+        total_counters[i] += counters[i];
     }
+}
+
+// Returns the given counter value as a per mil proportion of the total
+static u64 permil(u64 value, u64 total) {
+    return total ? value * 1000 / total : 0;
+}
+#endif
+
+void tt_show_stats(TranspositionTable *tt, const TtStats *stats) {
+    sync_lock_stdout();
+    printf("info string TT hashfull %" PRIu16 "\n", tt_hashfull(tt));
+
+#ifdef TT_STATS
+    printf(
+        "info string TT probes %" PRIu64 " hits %" PRIu64 " (%" PRIu64 " permil) cutoffs %" PRIu64
+        " (%" PRIu64 " permil) collisions %" PRIu64 " stale clusters %" PRIu64 "\n",
+        stats->probes,
+        stats->hits,
+        permil(stats->hits, stats->probes),
+        stats->cutoffs,
+        permil(stats->cutoffs, stats->probes),
+        stats->collisions,
+        stats->stale_clusters
+    );
+    printf(
+        "info string TT saves: replaced empty %" PRIu64 " aged %" PRIu64 " shallower %" PRIu64
+        " same key updated %" PRIu64 " preserved %" PRIu64 "\n",
+        stats->replaced_empty,
+        stats->replaced_aged,
+        stats->replaced_shallower,
+        stats->updated_same_key,
+        stats->preserved_same_key
+    );
+#else
+    (void)stats;
+#endif
+
+    fflush(stdout);
+    sync_unlock_stdout();
+}
+
+void tt_resize(
+    TranspositionTable *tt,
+    usize size_mb,
+    usize thread_count,
+    LargePagesPolicy large_pages,
+    const char *shared_name
+) {
+    const u64 layout_tag = ((u64)TT_FILE_VERSION << 32) | sizeof(TranspositionEntry);
+    bool created;
+
+    tt_destroy(tt);
 
     // Note: 1000000 is already a multiple of 64, and we static_assert that TranspositionCluster's
     // size divides 64, so we don't need any extra rounding for aligned_alloc() here.
     tt->cluster_count = size_mb * 1024 * 1024 / sizeof(TranspositionCluster);
-    tt->table = wrap_aligned_alloc(64, tt->cluster_count * sizeof(TranspositionCluster));
-    tt_init_new_game(tt, thread_count);
+
+    if (shared_name != NULL
+        && (tt->table = shared_alloc(
+                shared_name,
+                tt->cluster_count * sizeof(TranspositionCluster),
+                layout_tag,
+                &created
+            ))
+               != NULL) {
+        // Shared segments are zero-filled on creation, and must not be cleared when attaching to
+        // them since other processes may be using their contents. Our own epoch may have moved on
+        // with lazy clearing, so switch to the one shared by all processes.
+        tt->page_kind = PageKindShared;
+        tt->generation = 0;
+        tt->epoch = TT_SHARED_EPOCH;
+
+        if (created) {
+            numa_interleave_memory(tt->table, tt->cluster_count * sizeof(TranspositionCluster));
+        }
+
+        return;
+    }
+
+    tt->table = wrap_large_alloc(
+        tt->cluster_count * sizeof(TranspositionCluster),
+        large_pages,
+        &tt->page_kind
+    );
+
+    // Spread the table over all NUMA nodes before zeroing it, so that no single memory controller
+    // has to serve all threads.
+    numa_interleave_memory(tt->table, tt->cluster_count * sizeof(TranspositionCluster));
+
+    // Huge pages mapped by the kernel are already zero-filled, so lazy clearing can skip the
+    // costly initial pass over the table.
+    if (tt->lazy_clear && (tt->page_kind == PageKindHuge2M || tt->page_kind == PageKindHuge1G)) {
+        tt->generation = 0;
+    } else {
+        tt_clear(tt, thread_count);
+    }
+}
+
+void tt_resize_small(TranspositionTable *tt, usize size_kb) {
+    tt_destroy(tt);
+    tt->cluster_count = size_kb * 1024 / sizeof(TranspositionCluster);
+    tt->table = tt->cluster_count != 0
+        ? wrap_aligned_alloc(64, tt->cluster_count * sizeof(TranspositionCluster))
+        : NULL;
+    tt->page_kind = PageKindDefault;
+    tt->generation = 0;
+}
+
+bool tt_dump_to_file(const TranspositionTable *tt, const char *filename) {
+    // Write to a temporary file first, and move it over the target once complete. The target may
+    // be the file the table is currently mapped from, which must not be truncated while we read
+    // the table, and this also keeps the previous save intact if the write fails.
+    const usize name_length = strlen(filename);
+    char *tmp_filename = wrap_malloc(name_length + 5);
+    u8 header_block[TT_FILE_HEADER_SIZE] = {0};
+    TtFileHeader header;
+    bool success;
+    FILE *f;
+
+    memcpy(tmp_filename, filename, name_length);
+    memcpy(tmp_filename + name_length, ".tmp", 5);
+    f = fopen(tmp_filename, "wb");
+
+    if (f == NULL) {
+        free(tmp_filename);
+        return false;
+    }
+
+    memset(&header, 0, sizeof(TtFileHeader));
+    memcpy(header.magic, TtFileMagic, sizeof(TtFileMagic));
+    header.version = TT_FILE_VERSION;
+    header.entry_size = sizeof(TranspositionEntry);
+    header.cluster_count = tt->cluster_count;
+    header.epoch = tt->epoch;
+    header.generation = tt->generation;
+    memcpy(header_block, &header, sizeof(TtFileHeader));
+
+    success = fwrite(header_block, TT_FILE_HEADER_SIZE, 1, f) == 1
+        && fwrite(tt->table, sizeof(TranspositionCluster), tt->cluster_count, f)
+               == tt->cluster_count;
+    success = fclose(f) == 0 && success;
+    success = success && rename(tmp_filename, filename) == 0;
+
+    if (!success) {
+        remove(tmp_filename);
+    }
+
+    free(tmp_filename);
+    return success;
+}
+
+// Tries to map the clusters of the file in memory without copying them. Pages are only duplicated
+// once the search writes to them, and the file itself is never modified.
+static bool tt_map_file(TranspositionTable *tt, FILE *f) {
+#if defined(__linux__)
+    const usize table_size = tt->cluster_count * sizeof(TranspositionCluster);
+    const int fd = fileno(f);
+    struct stat file_stat;
+    void *ptr;
+
+    if (TT_FILE_HEADER_SIZE % sysconf(_SC_PAGESIZE) != 0 || fstat(fd, &file_stat)
+        || (usize)file_stat.st_size < TT_FILE_HEADER_SIZE + table_size) {
+        return false;
+    }
+
+    ptr = mmap(NULL, table_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, TT_FILE_HEADER_SIZE);
+
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+
+    tt_destroy(tt);
+    tt->table = ptr;
+    tt->page_kind = PageKindFileMapping;
+    numa_interleave_memory(tt->table, table_size);
+    return true;
+#else
+    (void)tt;
+    (void)f;
+    return false;
+#endif
+}
+
+TtLoadStatus tt_load_from_file(TranspositionTable *tt, const char *filename, usize thread_count) {
+    FILE *f = fopen(filename, "rb");
+    TtFileHeader header;
+    TtLoadStatus status;
+
+    if (f == NULL) {
+        return TtLoadIoError;
+    }
+
+    if (fread(&header, sizeof(TtFileHeader), 1, f) != 1
+        || fseek(f, TT_FILE_HEADER_SIZE, SEEK_SET)) {
+        fclose(f);
+        return TtLoadIoError;
+    }
+
+    if (memcmp(header.magic, TtFileMagic, sizeof(TtFileMagic)) || header.version != TT_FILE_VERSION
+        || header.entry_size != sizeof(TranspositionEntry) || header.cluster_count == 0
+        || (u32)header.epoch == 0) {
+        fclose(f);
+        return TtLoadBadFormat;
+    }
+
+    // Entries only store a fragment of their key, so they can't be moved to another cluster.
+    if (header.cluster_count != tt->cluster_count) {
+        fclose(f);
+        return TtLoadSizeMismatch;
+    }
+
+    // Shared tables are never replaced by a private mapping, so that the loaded contents are
+    // visible to all attached processes.
+    if (tt->page_kind != PageKindShared && tt_map_file(tt, f)) {
+        status = TtLoadMapped;
+    } else if (fread(tt->table, sizeof(TranspositionCluster), tt->cluster_count, f)
+               == tt->cluster_count) {
+        status = TtLoadCopied;
+    } else {
+        status = TtLoadIoError;
+    }
+
+    fclose(f);
+
+    // Don't leave a partially loaded table behind.
+    if (status == TtLoadIoError) {
+        tt_clear(tt, thread_count);
+    } else if (tt->page_kind == PageKindShared) {
+        // Attached processes wouldn't follow an epoch change, so the clusters that were valid in
+        // the file are retagged with the shared epoch instead, and the others are marked stale.
+        for (usize i = 0; i < tt->cluster_count; ++i) {
+            TranspositionCluster *cluster = &tt->table[i];
+
+            cluster->epoch_tag = cluster->epoch_tag == (u32)header.epoch ? tt_epoch_tag(tt) : 0;
+        }
+
+        tt->generation = header.generation;
+    } else {
+        tt->epoch = header.epoch;
+        tt->generation = header.generation;
+    }
+
+    return status;
 }
@@ -19,38 +19,277 @@
 #include "uci.h"
 
 #include "evaluate.h"
+#include "nnue.h"
+#include "numa.h"
 #include "search_params.h"
 #include "strmanip.h"
 #include "syncio.h"
 #include "wdl.h"
 #include "wmalloc.h"
 
-#define UCI_VERSION "v37.24"
+#define UCI_VERSION "v37.65"
 
 static const Command UciCommands[] = {
+    {STATIC_STRVIEW("batch"), uci_batch},
     {STATIC_STRVIEW("bench"), uci_bench},
     {STATIC_STRVIEW("d"), uci_d},
+    {STATIC_STRVIEW("datagen"), uci_datagen},
     {STATIC_STRVIEW("debug"), uci_debug},
     {STATIC_STRVIEW("go"), uci_go},
     {STATIC_STRVIEW("isready"), uci_isready},
+    {STATIC_STRVIEW("loadhash"), uci_loadhash},
     {STATIC_STRVIEW("ponderhit"), uci_ponderhit},
     {STATIC_STRVIEW("position"), uci_position},
     {STATIC_STRVIEW("quit"), uci_quit},
+    {STATIC_STRVIEW("savehash"), uci_savehash},
     {STATIC_STRVIEW("setoption"), uci_setoption},
+    {STATIC_STRVIEW("speedtest"), uci_speedtest},
     {STATIC_STRVIEW("stop"), uci_stop},
     {STATIC_STRVIEW("t"), uci_t},
+    {STATIC_STRVIEW("ttstats"), uci_ttstats},
     {STATIC_STRVIEW("uci"), uci_uci},
     {STATIC_STRVIEW("ucinewgame"), uci_ucinewgame},
 };
 
+static LargePagesPolicy uci_large_pages_policy(const Uci *uci) {
+    const StringView value = strview_from_string(&uci->option_values.large_pages);
+
+    if (strview_equals_strview(value, STATIC_STRVIEW("Off"))) {
+        return LargePagesOff;
+    }
+
+    if (strview_equals_strview(value, STATIC_STRVIEW("Transparent"))) {
+        return LargePagesTransparent;
+    }
+
+    return LargePagesAuto;
+}
+
+// Builds the null-terminated name of the shared memory segment to use for the TT. Returns false if
+// the TT isn't shared
+static bool uci_init_shared_hash_name(const Uci *uci, String *shared_name) {
+    const StringView shared_value = strview_from_string(&uci->option_values.shared_hash);
+
+    string_init(shared_name);
+
+    if (shared_value.size == 0 || strview_equals_strview(shared_value, STATIC_STRVIEW("<empty>"))) {
+        return false;
+    }
+
+    // POSIX shared memory object names must start with a slash.
+    if (!strview_starts_with(shared_value, '/')) {
+        string_push_back(shared_name, '/');
+    }
+
+    string_push_back_strview(shared_name, shared_value);
+    string_push_back(shared_name, '\0');
+    return true;
+}
+
+// Waits for a pending TT resize to complete, and reports the resulting table. The report uses the
+// parameters of the resize itself, as the options may have changed since it started.
+static void uci_wait_hash_resize(Uci *uci) {
+    const TranspositionTable *tt = &uci->worker_pool.tt;
+    const TtResizeJob *job = &uci->worker_pool.tt_resize;
+
+    if (!wpool_wait_tt_resize(&uci->worker_pool)) {
+        return;
+    }
+
+    sync_lock_stdout();
+
+    if (job->shared_name != NULL && tt->page_kind != PageKindShared) {
+        printf(
+            "info string Unable to attach shared hash table '%s', falling back to private memory\n",
+            job->shared_name
+        );
+    }
+
+    printf(
+        "info string Hash table of " FORMAT_LARGE_INT " MB allocated with %s\n",
+        (LargeInt)job->size_mb,
+        page_kind_name(tt->page_kind)
+    );
+    fflush(stdout);
+    sync_unlock_stdout();
+}
+
+// Starts resizing the TT in the background. The new table is reported once a command needing it
+// waits for the resize to complete.
+static void uci_resize_hash(Uci *uci) {
+    String shared_name;
+    const bool use_shared = uci_init_shared_hash_name(uci, &shared_name);
+
+    // Report the previous resize if it is still pending, since starting a new one would join it.
+    uci_wait_hash_resize(uci);
+    wpool_resize_tt(
+        &uci->worker_pool,
+        (u64)uci->option_values.hash,
+        (u64)uci->option_values.threads,
+        uci_large_pages_policy(uci),
+        use_shared ? (const char *)shared_name.data : NULL
+    );
+    string_destroy(&shared_name);
+}
+
 void on_threads_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
     Uci *uci = (Uci *)uci_ptr;
+    uci_wait_hash_resize(uci);
     wpool_resize(&uci->worker_pool, (u64)uci->option_values.threads);
 }
 
+void on_qcache_size_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    Uci *uci = (Uci *)uci_ptr;
+    wpool_set_qcache_size(&uci->worker_pool, (u64)uci->option_values.qcache_size);
+}
+
+void on_eval_cache_size_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    Uci *uci = (Uci *)uci_ptr;
+    wpool_set_eval_cache_size(&uci->worker_pool, (u64)uci->option_values.eval_cache_size);
+}
+
+void on_king_pawn_hash_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    Uci *uci = (Uci *)uci_ptr;
+    wpool_set_king_pawn_size(&uci->worker_pool, (u64)uci->option_values.king_pawn_hash);
+}
+
+void on_perft_hash_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    Uci *uci = (Uci *)uci_ptr;
+    wpool_set_perft_hash_size(&uci->worker_pool, (u64)uci->option_values.perft_hash);
+}
+
 void on_hash_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    uci_resize_hash((Uci *)uci_ptr);
+}
+
+void on_large_pages_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    uci_resize_hash((Uci *)uci_ptr);
+}
+
+void on_shared_hash_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    uci_resize_hash((Uci *)uci_ptr);
+}
+
+void on_numa_aware_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    Uci *uci = (Uci *)uci_ptr;
+
+    if (numa_node_count() == 1) {
+        numa_set_enabled(uci->option_values.numa_aware);
+        return;
+    }
+
+    // Thread and memory placement is only done at allocation time, so we need to recreate the
+    // workers and the hash table for the change to take effect.
+    uci_wait_hash_resize(uci);
+    wpool_resize(&uci->worker_pool, 0);
+    numa_set_enabled(uci->option_values.numa_aware);
+    wpool_resize(&uci->worker_pool, (u64)uci->option_values.threads);
+    uci_resize_hash(uci);
+}
+
+static ThreadBinding uci_thread_binding(const Uci *uci) {
+    static const char *BindingNames[] = {"None", "Compact", "Scatter", "NoSMT", "List"};
+    const StringView value = strview_from_string(&uci->option_values.thread_binding);
+
+    for (usize i = 0; i < sizeof(BindingNames) / sizeof(BindingNames[0]); ++i) {
+        if (strview_equals_strview(value, strview_from_cstr(BindingNames[i]))) {
+            return (ThreadBinding)i;
+        }
+    }
+
+    return ThreadBindingNone;
+}
+
+void on_thread_binding_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    Uci *uci = (Uci *)uci_ptr;
+    const StringView cpu_list = strview_from_string(&uci->option_values.thread_cpu_list);
+
+    if (!numa_set_thread_binding(uci_thread_binding(uci), cpu_list)) {
+        sync_lock_stdout();
+        printf(
+            "info string No usable CPU for thread binding '%.*s' with CPU list '%.*s', threads "
+            "will not be pinned\n",
+            (int)uci->option_values.thread_binding.size,
+            (const char *)uci->option_values.thread_binding.data,
+            (int)cpu_list.size,
+            (const char *)cpu_list.data
+        );
+        fflush(stdout);
+        sync_unlock_stdout();
+    }
+
+    // Threads are only pinned when they are spawned, so we need to recreate the workers for the
+    // change to take effect.
+    uci_wait_hash_resize(uci);
+    wpool_resize(&uci->worker_pool, 0);
+    wpool_resize(&uci->worker_pool, (u64)uci->option_values.threads);
+}
+
+void on_thread_cpu_list_change(const OptionParams *params, void *uci_ptr) {
+    if (uci_thread_binding((const Uci *)uci_ptr) == ThreadBindingList) {
+        on_thread_binding_change(params, uci_ptr);
+    }
+}
+
+void on_lazy_hash_clear_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    Uci *uci = (Uci *)uci_ptr;
+
+    wpool_wait_search_completion(&uci->worker_pool);
+    uci_wait_hash_resize(uci);
+    tt_set_lazy_clear(&uci->worker_pool.tt, uci->option_values.lazy_hash_clear);
+}
+
+void on_eval_file_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    Uci *uci = (Uci *)uci_ptr;
+    const StringView value = strview_from_string(&uci->option_values.eval_file);
+    String filename;
+
+    // Workers read the network during the search, so don't swap it under their feet. Evals computed
+    // with the previous network are stored in the TT, the eval caches and the correction histories,
+    // so start a new game to flush them all.
+    uci_ucinewgame(uci, EmptyStrview);
+
+    if (value.size == 0 || strview_equals_strview(value, STATIC_STRVIEW("<empty>"))) {
+        nnue_unload();
+        return;
+    }
+
+    string_init_from_strview(&filename, value);
+    string_push_back(&filename, '\0');
+
+    const NnueLoadStatus status = nnue_load((const char *)filename.data);
+
+    sync_lock_stdout();
+    printf(
+        "info string Network '%s': %s\n",
+        (const char *)filename.data,
+        nnue_load_status_name(status)
+    );
+    fflush(stdout);
+    sync_unlock_stdout();
+    string_destroy(&filename);
+}
+
+void on_use_nnue_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
+    Uci *uci = (Uci *)uci_ptr;
+
+    // Flush the evals computed with the previous evaluation function, like for EvalFile.
+    uci_ucinewgame(uci, EmptyStrview);
+    nnue_set_enabled(uci->option_values.use_nnue);
+
+    if (uci->option_values.use_nnue && !nnue_is_active()) {
+        sync_lock_stdout();
+        printf("info string No network loaded, using the classical evaluation\n");
+        fflush(stdout);
+        sync_unlock_stdout();
+    }
+}
+
+void on_lazy_eval_margin_change(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
     Uci *uci = (Uci *)uci_ptr;
-    tt_resize(&uci->worker_pool.tt, (u64)uci->option_values.hash, (u64)uci->option_values.threads);
+
+    wpool_wait_search_completion(&uci->worker_pool);
+    evaluate_set_lazy_margin((Score)uci->option_values.lazy_eval_margin);
 }
 
 void on_clear_hash(__attribute__((unused)) const OptionParams *params, void *uci_ptr) {
@@ -61,6 +300,10 @@ static void uci_init_options(Uci *uci) {
     uci->option_values = (OptionValues) {
         .threads = 1,
         .hash = 1,
+        .qcache_size = 0,
+        .eval_cache_size = EVAL_CACHE_DEFAULT_KB,
+        .king_pawn_hash = KING_PAWN_DEFAULT_KB,
+        .perft_hash = 0,
         .move_overhead = 30,
         .multi_pv = 1,
         .chess960 = false,
@@ -68,8 +311,16 @@ static void uci_init_options(Uci *uci) {
         .show_wdl = false,
         .normalize_score = true,
         .tm_for_nodes = false,
+        .numa_aware = true,
+        .lazy_hash_clear = false,
     };
 
+    string_init_from_cstr(&uci->option_values.large_pages, "Auto");
+    string_init_from_cstr(&uci->option_values.shared_hash, "<empty>");
+    string_init_from_cstr(&uci->option_values.thread_binding, "None");
+    string_init_from_cstr(&uci->option_values.thread_cpu_list, "<empty>");
+    string_init_from_cstr(&uci->option_values.eval_file, "<empty>");
+
     optlist_init(&uci->option_list);
     optlist_add_spin_integer(
         &uci->option_list,
@@ -91,6 +342,46 @@ static void uci_init_options(Uci *uci) {
         on_hash_change,
         (void *)uci
     );
+    optlist_add_spin_integer(
+        &uci->option_list,
+        strview_from_cstr("QCacheSize"),
+        &uci->option_values.qcache_size,
+        0,
+        65536,
+        false,
+        on_qcache_size_change,
+        (void *)uci
+    );
+    optlist_add_spin_integer(
+        &uci->option_list,
+        strview_from_cstr("EvalCacheSize"),
+        &uci->option_values.eval_cache_size,
+        0,
+        65536,
+        false,
+        on_eval_cache_size_change,
+        (void *)uci
+    );
+    optlist_add_spin_integer(
+        &uci->option_list,
+        strview_from_cstr("KingPawnHash"),
+        &uci->option_values.king_pawn_hash,
+        16,
+        65536,
+        false,
+        on_king_pawn_hash_change,
+        (void *)uci
+    );
+    optlist_add_spin_integer(
+        &uci->option_list,
+        strview_from_cstr("PerftHash"),
+        &uci->option_values.perft_hash,
+        0,
+        65536,
+        false,
+        on_perft_hash_change,
+        (void *)uci
+    );
     optlist_add_spin_integer(
         &uci->option_list,
         strview_from_cstr("MoveOverhead"),
@@ -146,6 +437,82 @@ static void uci_init_options(Uci *uci) {
         NULL,
         NULL
     );
+    optlist_add_combo(
+        &uci->option_list,
+        strview_from_cstr("LargePages"),
+        &uci->option_values.large_pages,
+        on_large_pages_change,
+        (void *)uci,
+        3,
+        STATIC_STRVIEW("Auto"),
+        STATIC_STRVIEW("Transparent"),
+        STATIC_STRVIEW("Off")
+    );
+    optlist_add_string(
+        &uci->option_list,
+        strview_from_cstr("SharedHash"),
+        &uci->option_values.shared_hash,
+        on_shared_hash_change,
+        (void *)uci
+    );
+    optlist_add_check(
+        &uci->option_list,
+        strview_from_cstr("NumaAware"),
+        &uci->option_values.numa_aware,
+        on_numa_aware_change,
+        (void *)uci
+    );
+    optlist_add_combo(
+        &uci->option_list,
+        strview_from_cstr("ThreadBinding"),
+        &uci->option_values.thread_binding,
+        on_thread_binding_change,
+        (void *)uci,
+        5,
+        STATIC_STRVIEW("None"),
+        STATIC_STRVIEW("Compact"),
+        STATIC_STRVIEW("Scatter"),
+        STATIC_STRVIEW("NoSMT"),
+        STATIC_STRVIEW("List")
+    );
+    optlist_add_string(
+        &uci->option_list,
+        strview_from_cstr("ThreadCpuList"),
+        &uci->option_values.thread_cpu_list,
+        on_thread_cpu_list_change,
+        (void *)uci
+    );
+    optlist_add_check(
+        &uci->option_list,
+        strview_from_cstr("LazyHashClear"),
+        &uci->option_values.lazy_hash_clear,
+        on_lazy_hash_clear_change,
+        (void *)uci
+    );
+    optlist_add_string(
+        &uci->option_list,
+        strview_from_cstr("EvalFile"),
+        &uci->option_values.eval_file,
+        on_eval_file_change,
+        (void *)uci
+    );
+    optlist_add_check(
+        &uci->option_list,
+        strview_from_cstr("UseNNUE"),
+        &uci->option_values.use_nnue,
+        on_use_nnue_change,
+        (void *)uci
+    );
+    optlist_add_spin_integer(
+        &uci->option_list,
+        strview_from_cstr("LazyEvalMargin"),
+        &uci->option_values.lazy_eval_margin,
+        0,
+        2000,
+        false,
+        on_lazy_eval_margin_change,
+        (void *)uci
+    );
     optlist_add_button(
         &uci->option_list,
         strview_from_cstr("Clear Hash"),
@@ -159,12 +526,21 @@ void uci_init(Uci *uci) {
 
     uci_init_options(uci);
     board_try_init(&uci->root_board, StartposStr, false, stack);
-    wpool_init(&uci->worker_pool);
+    uci->batch_run = NULL;
+
+    // The TT starts with 16 MB until the Hash option is set.
+    wpool_init(&uci->worker_pool, 0, 16, uci->option_values.lazy_hash_clear);
 }
 
 void uci_destroy(Uci *uci) {
     wpool_destroy(&uci->worker_pool);
     optlist_destroy(&uci->option_list);
+    string_destroy(&uci->option_values.large_pages);
+    string_destroy(&uci->option_values.shared_hash);
+    string_destroy(&uci->option_values.thread_binding);
+    string_destroy(&uci->option_values.thread_cpu_list);
+    string_destroy(&uci->option_values.eval_file);
+    nnue_unload();
     boardstack_destroy(uci->root_board.stack);
 }
 
@@ -226,14 +602,71 @@ void uci_go(Uci *uci, StringView args) {
         uci->option_values.tm_for_nodes
     );
     search_params_set_from_uci(&search_params, &uci->root_board, args);
+    uci_wait_hash_resize(uci);
     wpool_start_search(&uci->worker_pool, &uci->root_board, &search_params);
 }
 
-void uci_isready(__attribute__((unused)) Uci *uci, __attribute__((unused)) StringView args) {
+void uci_isready(Uci *uci, __attribute__((unused)) StringView args) {
+    // Only answer once the hash table is usable, so that the GUI doesn't start the clock while we
+    // are still allocating it.
+    uci_wait_hash_resize(uci);
     puts("readyok");
     fflush(stdout);
 }
 
+// Converts the command arguments to a null-terminated filename. Returns false if the arguments are
+// empty
+static bool uci_init_filename(String *filename, StringView args) {
+    args = strview_trim_whitespaces(args);
+
+    if (args.size == 0) {
+        return false;
+    }
+
+    string_init_from_strview(filename, args);
+    string_push_back(filename, '\0');
+    return true;
+}
+
+void uci_loadhash(Uci *uci, StringView args) {
+    static const char *StatusMessages[] = {
+        "mapped in memory",
+        "copied in memory",
+        "unable to read the file",
+        "not a valid hash file",
+        "saved with a different Hash size",
+    };
+    String filename;
+    TtLoadStatus status;
+
+    if (!uci_init_filename(&filename, args)) {
+        sync_lock_stdout();
+        puts("info string Usage: loadhash <filename>");
+        fflush(stdout);
+        sync_unlock_stdout();
+        return;
+    }
+
+    wpool_wait_search_completion(&uci->worker_pool);
+    uci_wait_hash_resize(uci);
+    status = tt_load_from_file(
+        &uci->worker_pool.tt,
+        (const char *)filename.data,
+        (u64)uci->option_values.threads
+    );
+
+    sync_lock_stdout();
+    printf(
+        "info string Hash file '%s' %s: %s\n",
+        (const char *)filename.data,
+        status <= TtLoadCopied ? "loaded" : "rejected",
+        StatusMessages[status]
+    );
+    fflush(stdout);
+    sync_unlock_stdout();
+    string_destroy(&filename);
+}
+
 void uci_ponderhit(Uci *uci, __attribute__((unused)) StringView args) {
     wpool_ponderhit(&uci->worker_pool);
 }
@@ -319,6 +752,34 @@ void uci_position(Uci *uci, StringView args) {
 
 void uci_quit(Uci *uci, __attribute__((unused)) StringView args) {
     wpool_stop(&uci->worker_pool);
+    uci_stop_batch(uci);
+}
+
+void uci_savehash(Uci *uci, StringView args) {
+    String filename;
+    bool success;
+
+    if (!uci_init_filename(&filename, args)) {
+        sync_lock_stdout();
+        puts("info string Usage: savehash <filename>");
+        fflush(stdout);
+        sync_unlock_stdout();
+        return;
+    }
+
+    wpool_wait_search_completion(&uci->worker_pool);
+    uci_wait_hash_resize(uci);
+    success = tt_dump_to_file(&uci->worker_pool.tt, (const char *)filename.data);
+
+    sync_lock_stdout();
+    printf(
+        "info string %s hash file '%s'\n",
+        success ? "Saved" : "Unable to save",
+        (const char *)filename.data
+    );
+    fflush(stdout);
+    sync_unlock_stdout();
+    string_destroy(&filename);
 }
 
 void uci_setoption(Uci *uci, StringView args) {
@@ -361,12 +822,27 @@ void uci_setoption(Uci *uci, StringView args) {
 
 void uci_stop(Uci *uci, __attribute__((unused)) StringView args) {
     wpool_stop(&uci->worker_pool);
+    uci_stop_batch(uci);
 }
 
 void uci_t(Uci *uci, __attribute__((unused)) StringView args) {
     optlist_show_tunable_options(&uci->option_list);
 }
 
+void uci_ttstats(Uci *uci, __attribute__((unused)) StringView args) {
+    wpool_wait_search_completion(&uci->worker_pool);
+    uci_wait_hash_resize(uci);
+
+#ifdef TT_STATS
+    TtStats stats;
+
+    wpool_get_tt_stats(&uci->worker_pool, &stats);
+    tt_show_stats(&uci->worker_pool.tt, &stats);
+#else
+    tt_show_stats(&uci->worker_pool.tt, NULL);
+#endif
+}
+
 void uci_uci(Uci *uci, __attribute__((unused)) StringView args) {
     puts("id name Stash " UCI_VERSION);
     puts("id author Morgan Houppin et al. (see AUTHORS file)");
@@ -377,6 +853,7 @@ void uci_uci(Uci *uci, __attribute__((unused)) StringView args) {
 
 void uci_ucinewgame(Uci *uci, __attribute__((unused)) StringView args) {
     wpool_wait_search_completion(&uci->worker_pool);
+    uci_wait_hash_resize(uci);
     wpool_init_new_game(&uci->worker_pool);
 }
 
@@ -426,6 +903,9 @@ void uci_loop(int argc, char **argv) {
         string_destroy(&line);
     }
 
+    // A batch analysis only gets stopped by an explicit quit command, so that it can be started
+    // from the command line or from a script.
+    uci_wait_batch(&uci);
     uci_quit(&uci, EmptyStrview);
     wpool_wait_search_completion(&uci.worker_pool);
     uci_destroy(&uci);
@@ -28,6 +28,22 @@
 #include <malloc.h>
 #endif
 
+// Huge page support is only implemented for Linux for now.
+#if defined(__linux__)
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+static const usize HugePageSize2M = (usize)1 << 21;
+static const usize HugePageSize1G = (usize)1 << 30;
+#endif
+
 static isize log_usize(usize value) {
     char buf[20];
     usize i = 20;
@@ -112,3 +128,241 @@ void wrap_aligned_free_internal(
     free(ptr);
 #endif
 }
+
+const char *page_kind_name(PageKind page_kind) {
+    static const char *PageKindNames[] = {
+        "default pages",
+        "transparent huge pages",
+        "2MB huge pages",
+        "1GB huge pages",
+        "a file mapping",
+        "a shared memory segment",
+    };
+
+    return PageKindNames[page_kind];
+}
+
+#if defined(__linux__) && defined(MAP_HUGETLB)
+static void *try_hugetlb_alloc(usize size, usize page_size, int size_flag) {
+    void *ptr = mmap(
+        NULL,
+        usize_next_multiple_of(size, page_size),
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (size_flag << MAP_HUGE_SHIFT),
+        -1,
+        0
+    );
+
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+#endif
+
+#if defined(__linux__)
+enum {
+    // The header is padded to a full page to keep the shared data page-aligned.
+    SHARED_HEADER_SIZE = 4096,
+
+    // Number of attempts (spaced by 10ms) at attaching to a segment that is still being set up
+    SHARED_ATTACH_ATTEMPTS = 100,
+};
+
+static const char SharedMagic[8] = "StashSH";
+
+// Struct for the header placed at the start of each shared memory segment
+typedef struct {
+    char magic[8];
+    u64 size;
+    u64 layout_tag;
+} SharedHeader;
+
+// Attaches to a segment created by another process. The creator may still be sizing the segment or
+// writing its header, which is recognized by a zero size or a zeroed magic, so we retry for a short
+// while in these cases instead of rejecting the segment.
+static void *shared_attach(const char *name, usize size, u64 layout_tag) {
+    const usize total_size = SHARED_HEADER_SIZE + size;
+    static const char NoMagic[8] = {0};
+
+    for (usize attempt = 0; attempt < SHARED_ATTACH_ATTEMPTS; ++attempt) {
+        struct stat segment_stat;
+        SharedHeader *header;
+        int fd = shm_open(name, O_RDWR, 0600);
+
+        if (fd < 0) {
+            return NULL;
+        }
+
+        if (fstat(fd, &segment_stat)) {
+            close(fd);
+            return NULL;
+        }
+
+        if (segment_stat.st_size == 0) {
+            close(fd);
+            usleep(10000);
+            continue;
+        }
+
+        if ((usize)segment_stat.st_size != total_size) {
+            close(fd);
+            return NULL;
+        }
+
+        header = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (header == MAP_FAILED) {
+            return NULL;
+        }
+
+        // The creator writes the magic last, so the other fields are valid once it is set.
+        if (!memcmp(header->magic, NoMagic, sizeof(NoMagic))) {
+            munmap(header, total_size);
+            usleep(10000);
+            continue;
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+
+        // Segments created for another size or data layout are rejected.
+        if (memcmp(header->magic, SharedMagic, sizeof(SharedMagic)) || header->size != size
+            || header->layout_tag != layout_tag) {
+            munmap(header, total_size);
+            return NULL;
+        }
+
+        return (u8 *)header + SHARED_HEADER_SIZE;
+    }
+
+    return NULL;
+}
+#endif
+
+void *shared_alloc(const char *name, usize size, u64 layout_tag, bool *created) {
+#if defined(__linux__)
+    const usize total_size = SHARED_HEADER_SIZE + size;
+    SharedHeader *header;
+    int fd;
+
+    // Try to create the segment first, and attach to the existing one if another process already
+    // did so.
+    *created = true;
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if (fd < 0) {
+        *created = false;
+        return shared_attach(name, size, layout_tag);
+    }
+
+    if (ftruncate(fd, (off_t)total_size)) {
+        close(fd);
+
+        // Don't leave a half-initialized segment behind us.
+        shm_unlink(name);
+        return NULL;
+    }
+
+    header = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (header == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // Newly created segments are zero-filled by the kernel, so the only thing left to do is to
+    // write the header. The magic comes last, as it tells attaching processes that the header is
+    // complete.
+    header->size = size;
+    header->layout_tag = layout_tag;
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, SharedMagic, sizeof(SharedMagic));
+
+    return (u8 *)header + SHARED_HEADER_SIZE;
+#else
+    (void)name;
+    (void)size;
+    (void)layout_tag;
+    *created = false;
+    return NULL;
+#endif
+}
+
+void *wrap_large_alloc_internal(
+    usize size,
+    LargePagesPolicy policy,
+    PageKind *page_kind,
+    const char *source_file,
+    usize line
+) {
+    void *ptr;
+
+#if defined(__linux__) && defined(MAP_HUGETLB)
+    // Explicit huge pages require the administrator to reserve them beforehand, so we expect these
+    // allocations to fail on most systems, and silently fall back to the other strategies.
+    if (policy == LargePagesAuto) {
+        if (size >= HugePageSize1G && (ptr = try_hugetlb_alloc(size, HugePageSize1G, 30)) != NULL) {
+            *page_kind = PageKindHuge1G;
+            return ptr;
+        }
+
+        if (size >= HugePageSize2M && (ptr = try_hugetlb_alloc(size, HugePageSize2M, 21)) != NULL) {
+            *page_kind = PageKindHuge2M;
+            return ptr;
+        }
+    }
+#endif
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // Align the allocation on huge page boundaries, and ask the kernel to back it with transparent
+    // huge pages if possible.
+    if (policy != LargePagesOff && size >= HugePageSize2M) {
+        const usize rounded_size = usize_next_multiple_of(size, HugePageSize2M);
+
+        if ((ptr = aligned_alloc(HugePageSize2M, rounded_size)) != NULL) {
+            madvise(ptr, rounded_size, MADV_HUGEPAGE);
+            *page_kind = PageKindTransparent;
+            return ptr;
+        }
+    }
+#else
+    (void)policy;
+#endif
+
+    ptr = wrap_aligned_alloc_internal(64, size, source_file, line);
+    *page_kind = PageKindDefault;
+    return ptr;
+}
+
+void wrap_large_free_internal(
+    void *ptr,
+    usize size,
+    PageKind page_kind,
+    const char *source_file,
+    usize line
+) {
+#if defined(__linux__)
+    if (page_kind == PageKindFileMapping) {
+        munmap(ptr, size);
+        return;
+    }
+
+    if (page_kind == PageKindShared) {
+        munmap((u8 *)ptr - SHARED_HEADER_SIZE, SHARED_HEADER_SIZE + size);
+        return;
+    }
+#endif
+
+#if defined(__linux__) && defined(MAP_HUGETLB)
+    if (page_kind == PageKindHuge1G || page_kind == PageKindHuge2M) {
+        const usize page_size = (page_kind == PageKindHuge1G) ? HugePageSize1G : HugePageSize2M;
+
+        munmap(ptr, usize_next_multiple_of(size, page_size));
+        return;
+    }
+#else
+    (void)size;
+    (void)page_kind;
+#endif
+
+    wrap_aligned_free_internal(ptr, source_file, line);
+}
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "numa.h"
 #include "search.h"
 #include "wmalloc.h"
 
@@ -85,8 +86,46 @@ void sort_root_moves(RootMove *root_moves, usize root_count) {
     }
 }
 
-void worker_init(Worker *worker, usize thread_index, struct WorkerPool *pool) {
-    worker->thread_index = thread_index;
+// Places the history tables of the worker on its NUMA node. This must be done before the tables
+// are first written to, since pages are physically allocated on first touch.
+static void worker_bind_tables(Worker *worker) {
+    const usize node = worker->numa_node;
+
+    numa_bind_memory(worker->butterfly_hist, sizeof(ButterflyHistory), node);
+    numa_bind_memory(worker->continuation_hist, sizeof(ContinuationHistory), node);
+    numa_bind_memory(worker->counter_hist, sizeof(CountermoveHistory), node);
+    numa_bind_memory(worker->capture_hist, sizeof(CaptureHistory), node);
+    numa_bind_memory(worker->pawn_corrhist, sizeof(CorrectionHistory), node);
+    numa_bind_memory(worker->nonpawn_corrhist, sizeof(CorrectionHistory) * COLOR_NB, node);
+    numa_bind_memory(worker->minor_corrhist, sizeof(CorrectionHistory), node);
+    numa_bind_memory(worker->major_corrhist, sizeof(CorrectionHistory), node);
+    numa_bind_memory(
+        worker->king_pawn_table.entries,
+        worker->king_pawn_table.entry_count * sizeof(KingPawnEntry),
+        node
+    );
+    numa_bind_memory(worker->material_table, sizeof(MaterialTable), node);
+
+    if (worker->qcache.table != NULL) {
+        numa_bind_memory(
+            worker->qcache.table,
+            worker->qcache.cluster_count * sizeof(TranspositionCluster),
+            node
+        );
+    }
+
+    if (worker->eval_cache.entries != NULL) {
+        numa_bind_memory(
+            worker->eval_cache.entries,
+            worker->eval_cache.entry_count * sizeof(EvalCacheEntry),
+            node
+        );
+    }
+}
+
+// Allocates the tables of the worker. This is called from the worker thread, so that the pages of
+// the tables are first touched from the thread using them.
+static void worker_alloc_tables(Worker *worker) {
     worker->butterfly_hist = wrap_aligned_alloc(64, sizeof(ButterflyHistory));
     worker->continuation_hist = wrap_aligned_alloc(64, sizeof(ContinuationHistory));
     worker->counter_hist = wrap_aligned_alloc(64, sizeof(CountermoveHistory));
@@ -95,11 +134,66 @@ void worker_init(Worker *worker, usize thread_index, struct WorkerPool *pool) {
     worker->nonpawn_corrhist = wrap_aligned_alloc(64, sizeof(CorrectionHistory) * COLOR_NB);
     worker->minor_corrhist = wrap_aligned_alloc(64, sizeof(CorrectionHistory));
     worker->major_corrhist = wrap_aligned_alloc(64, sizeof(CorrectionHistory));
-    worker->king_pawn_table = wrap_aligned_alloc(64, sizeof(KingPawnTable));
+    king_pawn_table_resize(&worker->king_pawn_table, worker->pool->king_pawn_kb);
+    worker->material_table = wrap_aligned_alloc(64, sizeof(MaterialTable));
+    worker->nnue_accumulators =
+        wrap_aligned_alloc(64, sizeof(NnueAccumulator) * (MAX_PLIES + 1));
     worker->root_moves = wrap_malloc(sizeof(RootMove) * MAX_MOVES);
-    worker->must_exit = false;
-    worker->is_searching = true;
+    tt_resize_small(&worker->qcache, worker->pool->qcache_kb);
+    eval_cache_resize(&worker->eval_cache, worker->pool->eval_cache_kb);
+    worker_bind_tables(worker);
+    worker_init_new_game(worker);
+}
+
+static void worker_resize_qcache(Worker *worker) {
+    tt_resize_small(&worker->qcache, worker->pool->qcache_kb);
+
+    if (worker->qcache.table != NULL) {
+        numa_bind_memory(
+            worker->qcache.table,
+            worker->qcache.cluster_count * sizeof(TranspositionCluster),
+            worker->numa_node
+        );
+        tt_clear(&worker->qcache, 1);
+    }
+}
+
+static void worker_resize_eval_cache(Worker *worker) {
+    eval_cache_resize(&worker->eval_cache, worker->pool->eval_cache_kb);
+
+    if (worker->eval_cache.entries != NULL) {
+        numa_bind_memory(
+            worker->eval_cache.entries,
+            worker->eval_cache.entry_count * sizeof(EvalCacheEntry),
+            worker->numa_node
+        );
+        eval_cache_clear(&worker->eval_cache);
+    }
+}
+
+static void worker_resize_king_pawn_table(Worker *worker) {
+    king_pawn_table_resize(&worker->king_pawn_table, worker->pool->king_pawn_kb);
+    numa_bind_memory(
+        worker->king_pawn_table.entries,
+        worker->king_pawn_table.entry_count * sizeof(KingPawnEntry),
+        worker->numa_node
+    );
+    king_pawn_table_clear(&worker->king_pawn_table);
+}
+
+void worker_init(Worker *worker, usize thread_index, struct WorkerPool *pool) {
+    worker->thread_index = thread_index;
+    worker->numa_node = numa_worker_node(pool->thread_offset + thread_index);
     worker->pool = pool;
+    tt_init(&worker->qcache);
+    eval_cache_init(&worker->eval_cache);
+    king_pawn_table_init(&worker->king_pawn_table);
+    worker->nodes = 0;
+    atomic_init(&worker->published_nodes, 0);
+
+    // The first task of the thread is to set up its own tables.
+    worker->task = WorkerTaskInitTables;
+    worker->is_busy = true;
 
     if (pthread_mutex_init(&worker->mutex, NULL) || pthread_cond_init(&worker->condvar, NULL)) {
         perror("Unable to initialize worker lock");
@@ -115,16 +209,10 @@ void worker_init(Worker *worker, usize thread_index, struct WorkerPool *pool) {
         perror("Unable to initialize worker thread");
         exit(EXIT_FAILURE);
     }
-
-    atomic_init(&worker->nodes, 0);
-    worker_init_new_game(worker);
 }
 
 void worker_destroy(Worker *worker) {
-    pthread_mutex_lock(&worker->mutex);
-    worker->must_exit = true;
-    pthread_mutex_unlock(&worker->mutex);
-    worker_start_searching(worker);
+    worker_start_task(worker, WorkerTaskExit);
 
     if (pthread_join(worker->thread, NULL)) {
         perror("Unable to stop worker");
@@ -141,7 +229,11 @@ void worker_destroy(Worker *worker) {
     wrap_aligned_free(worker->nonpawn_corrhist);
     wrap_aligned_free(worker->minor_corrhist);
     wrap_aligned_free(worker->major_corrhist);
-    wrap_aligned_free(worker->king_pawn_table);
+    king_pawn_table_destroy(&worker->king_pawn_table);
+    wrap_aligned_free(worker->material_table);
+    wrap_aligned_free(worker->nnue_accumulators);
+    tt_destroy(&worker->qcache);
+    eval_cache_destroy(&worker->eval_cache);
     free(worker->root_moves);
 }
 
@@ -154,13 +246,26 @@ void worker_init_new_game(Worker *worker) {
     memset(worker->nonpawn_corrhist, 0, sizeof(CorrectionHistory) * COLOR_NB);
     memset(worker->minor_corrhist, 0, sizeof(CorrectionHistory));
     memset(worker->major_corrhist, 0, sizeof(CorrectionHistory));
-    memset(worker->king_pawn_table, 0, sizeof(KingPawnTable));
+    king_pawn_table_clear(&worker->king_pawn_table);
+    memset(worker->material_table, 0, sizeof(MaterialTable));
+
+    if (worker->qcache.table != NULL) {
+        tt_clear(&worker->qcache, 1);
+    }
+
+    eval_cache_clear(&worker->eval_cache);
 }
 
-void worker_start_searching(Worker *worker) {
+void worker_start_task(Worker *worker, WorkerTask task) {
     pthread_mutex_lock(&worker->mutex);
-    worker->is_searching = true;
-    pthread_cond_signal(&worker->condvar);
+
+    while (worker->is_busy) {
+        pthread_cond_wait(&worker->condvar, &worker->mutex);
+    }
+
+    worker->task = task;
+    worker->is_busy = true;
+    pthread_cond_broadcast(&worker->condvar);
     pthread_mutex_unlock(&worker->mutex);
 }
 
@@ -170,8 +275,16 @@ void worker_init_search_data(Worker *worker) {
     board_clone(&worker->board, &worker->pool->root_board);
     board_enable_worker(&worker->board);
 
+    // Perft doesn't evaluate positions, so don't spend time updating the accumulators there.
+    if (nnue_is_active() && worker->pool->search_params.perft == 0) {
+        worker->board.accumulator = worker->nnue_accumulators;
+        nnue_accumulator_refresh(worker->board.accumulator, worker->board.mailbox);
+    }
+
     worker->seldepth = 0;
     worker->root_depth = 0;
+    worker->completed_depth = 0;
+    worker->completed_score = NO_SCORE;
     worker->nmp_verif_plies = 0;
     worker->root_move_count = movelist_size(searchmoves);
 
@@ -182,10 +295,10 @@ void worker_init_search_data(Worker *worker) {
     worker->pv_line = 0;
 }
 
-void worker_wait_search_completion(Worker *worker) {
+void worker_wait_task_completion(Worker *worker) {
     pthread_mutex_lock(&worker->mutex);
 
-    while (worker->is_searching) {
+    while (worker->is_busy) {
         pthread_cond_wait(&worker->condvar, &worker->mutex);
     }
 
@@ -195,37 +308,52 @@ void worker_wait_search_completion(Worker *worker) {
 void *worker_entry_point(void *worker_ptr) {
     Worker *worker = (Worker *)worker_ptr;
 
+    numa_bind_worker_thread(worker->pool->thread_offset + worker->thread_index);
+
     while (true) {
-        // Set the worker status as non-searching, and notify all waiting threads of the status
-        // change.
+        // Wait for a task from the UCI thread (or the main worker thread in the case of SMP).
         pthread_mutex_lock(&worker->mutex);
-        worker->is_searching = false;
-        pthread_cond_signal(&worker->condvar);
 
-        // Wait for a signal from the UCI thread (or the main worker thread in the case of SMP) to
-        // perform a task.
-        while (!worker->is_searching) {
+        while (!worker->is_busy) {
             pthread_cond_wait(&worker->condvar, &worker->mutex);
         }
 
-        if (worker->must_exit) {
-            pthread_mutex_unlock(&worker->mutex);
-            break;
-        }
+        const WorkerTask task = worker->task;
 
         pthread_mutex_unlock(&worker->mutex);
 
-        if (worker->thread_index == 0) {
-            main_worker_search(worker);
-        } else {
-            worker_search(worker);
+        if (task == WorkerTaskExit) {
+            break;
+        }
+
+        switch (task) {
+            case WorkerTaskSearch:
+                if (worker->thread_index == 0) {
+                    main_worker_search(worker);
+                } else {
+                    worker_search(worker);
+                }
+                break;
+
+            case WorkerTaskInitTables: worker_alloc_tables(worker); break;
+            case WorkerTaskResizeQcache: worker_resize_qcache(worker); break;
+            case WorkerTaskResizeEvalCache: worker_resize_eval_cache(worker); break;
+            case WorkerTaskResizeKingPawnTable: worker_resize_king_pawn_table(worker); break;
+            case WorkerTaskNewGame: worker_init_new_game(worker); break;
+            case WorkerTaskExit: break;
         }
+
+        // Set the worker status as idle, and notify all waiting threads of the status change.
+        pthread_mutex_lock(&worker->mutex);
+        worker->is_busy = false;
+        pthread_cond_broadcast(&worker->condvar);
+        pthread_mutex_unlock(&worker->mutex);
     }
 
     return NULL;
 }
 
-void wpool_init(WorkerPool *wpool) {
+void wpool_init(WorkerPool *wpool, usize thread_offset, usize hash_mb, bool lazy_clear) {
     if (pthread_attr_init(&wpool->worker_pthread_attr)
         || pthread_attr_setstacksize(&wpool->worker_pthread_attr, (usize)4 * 1024 * 1024)) {
         perror("Unable to initialize worker thread attributes");
@@ -234,12 +362,28 @@ void wpool_init(WorkerPool *wpool) {
 
     wpool->worker_count = 0;
     wpool->worker_list = NULL;
+    wpool->thread_offset = thread_offset;
     tt_init(&wpool->tt);
-    tt_resize(&wpool->tt, 16, 1);
+    wpool->tt.lazy_clear = lazy_clear;
+    tt_resize(&wpool->tt, hash_mb, 1, LargePagesAuto, NULL);
+    wpool->tt_resize.pending = false;
+    wpool->tt_resize.shared_name = NULL;
     memset(&wpool->root_board, 0, sizeof(Board));
     wpool->check_nodes = 0;
+    wpool->qcache_kb = 0;
+    wpool->eval_cache_kb = EVAL_CACHE_DEFAULT_KB;
+    wpool->king_pawn_kb = KING_PAWN_DEFAULT_KB;
+    perft_table_init(&wpool->perft_table);
+    atomic_init(&wpool->perft_next_root, 0);
     atomic_init(&wpool->ponder, false);
     atomic_init(&wpool->stop, false);
+
+    if (pthread_mutex_init(&wpool->release_mutex, NULL)
+        || pthread_cond_init(&wpool->release_condvar, NULL)) {
+        perror("Unable to initialize worker pool lock");
+        exit(EXIT_FAILURE);
+    }
+
     wpool_resize(wpool, 1);
 }
 
@@ -278,6 +422,8 @@ void wpool_resize(WorkerPool *wpool, usize worker_count) {
 
 void wpool_destroy(WorkerPool *wpool) {
     wpool_wait_search_completion(wpool);
+    wpool_wait_tt_resize(wpool);
+    free(wpool->tt_resize.shared_name);
 
     while (wpool->worker_count) {
         --wpool->worker_count;
@@ -291,15 +437,121 @@ void wpool_destroy(WorkerPool *wpool) {
     free(wpool->worker_list);
     boardstack_destroy(wpool->root_board.stack);
     pthread_attr_destroy(&wpool->worker_pthread_attr);
+    pthread_mutex_destroy(&wpool->release_mutex);
+    pthread_cond_destroy(&wpool->release_condvar);
+    perft_table_destroy(&wpool->perft_table);
     tt_destroy(&wpool->tt);
 }
 
 void wpool_init_new_game(WorkerPool *wpool) {
+    wpool_wait_tt_resize(wpool);
+
+    // All workers clear their own tables in parallel, while we take care of the TT.
     for (usize i = 0; i < wpool->worker_count; ++i) {
-        worker_init_new_game(wpool->worker_list[i]);
+        worker_start_task(wpool->worker_list[i], WorkerTaskNewGame);
     }
 
     tt_init_new_game(&wpool->tt, wpool->worker_count);
+
+    for (usize i = 0; i < wpool->worker_count; ++i) {
+        worker_wait_task_completion(wpool->worker_list[i]);
+    }
+}
+
+void wpool_set_qcache_size(WorkerPool *wpool, usize size_kb) {
+    wpool_wait_search_completion(wpool);
+    wpool->qcache_kb = size_kb;
+
+    for (usize i = 0; i < wpool->worker_count; ++i) {
+        worker_start_task(wpool->worker_list[i], WorkerTaskResizeQcache);
+    }
+
+    for (usize i = 0; i < wpool->worker_count; ++i) {
+        worker_wait_task_completion(wpool->worker_list[i]);
+    }
+}
+
+void wpool_set_eval_cache_size(WorkerPool *wpool, usize size_kb) {
+    wpool_wait_search_completion(wpool);
+    wpool->eval_cache_kb = size_kb;
+
+    for (usize i = 0; i < wpool->worker_count; ++i) {
+        worker_start_task(wpool->worker_list[i], WorkerTaskResizeEvalCache);
+    }
+
+    for (usize i = 0; i < wpool->worker_count; ++i) {
+        worker_wait_task_completion(wpool->worker_list[i]);
+    }
+}
+
+void wpool_set_king_pawn_size(WorkerPool *wpool, usize size_kb) {
+    wpool_wait_search_completion(wpool);
+    wpool->king_pawn_kb = size_kb;
+
+    for (usize i = 0; i < wpool->worker_count; ++i) {
+        worker_start_task(wpool->worker_list[i], WorkerTaskResizeKingPawnTable);
+    }
+
+    for (usize i = 0; i < wpool->worker_count; ++i) {
+        worker_wait_task_completion(wpool->worker_list[i]);
+    }
+}
+
+static void *wpool_tt_resize_entry_point(void *wpool_ptr) {
+    WorkerPool *wpool = (WorkerPool *)wpool_ptr;
+    const TtResizeJob *job = &wpool->tt_resize;
+
+    tt_resize(&wpool->tt, job->size_mb, job->thread_count, job->large_pages, job->shared_name);
+    return NULL;
+}
+
+void wpool_resize_tt(
+    WorkerPool *wpool,
+    usize size_mb,
+    usize thread_count,
+    LargePagesPolicy large_pages,
+    const char *shared_name
+) {
+    TtResizeJob *job = &wpool->tt_resize;
+
+    wpool_wait_search_completion(wpool);
+    wpool_wait_tt_resize(wpool);
+
+    job->size_mb = size_mb;
+    job->thread_count = thread_count;
+    job->large_pages = large_pages;
+    free(job->shared_name);
+    job->shared_name = NULL;
+
+    // Keep our own copy of the name, as the caller's buffer may not outlive the resize.
+    if (shared_name != NULL) {
+        job->shared_name = wrap_malloc(strlen(shared_name) + 1);
+        strcpy(job->shared_name, shared_name);
+    }
+
+    if (pthread_create(&job->thread, NULL, wpool_tt_resize_entry_point, wpool)) {
+        perror("Unable to create TT resize thread");
+        exit(EXIT_FAILURE);
+    }
+
+    job->pending = true;
+}
+
+bool wpool_wait_tt_resize(WorkerPool *wpool) {
+    TtResizeJob *job = &wpool->tt_resize;
+
+    if (!job->pending) {
+        return false;
+    }
+
+    pthread_join(job->thread, NULL);
+    job->pending = false;
+    return true;
+}
+
+void wpool_set_perft_hash_size(WorkerPool *wpool, usize size_mb) {
+    wpool_wait_search_completion(wpool);
+    perft_table_resize(&wpool->perft_table, size_mb);
 }
 
 void wpool_start_search(
@@ -308,6 +560,7 @@ void wpool_start_search(
     const SearchParams *search_params
 ) {
     wpool_wait_search_completion(wpool);
+    wpool_wait_tt_resize(wpool);
 
     atomic_store_explicit(&wpool->stop, false, memory_order_relaxed);
     atomic_store_explicit(&wpool->ponder, search_params->ponder, memory_order_relaxed);
@@ -318,12 +571,12 @@ void wpool_start_search(
     boardstack_destroy(wpool->root_board.stack);
     board_clone(&wpool->root_board, root_board);
     search_params_copy(&wpool->search_params, search_params);
-    worker_start_searching(wpool_main_worker(wpool));
+    worker_start_task(wpool_main_worker(wpool), WorkerTaskSearch);
 }
 
 void wpool_wait_search_completion(WorkerPool *wpool) {
     // The main thread is the last thread to complete search, so we can just wait for it.
-    worker_wait_search_completion(wpool->worker_list[0]);
+    worker_wait_task_completion(wpool->worker_list[0]);
 }
 
 void wpool_init_new_search(WorkerPool *wpool) {
@@ -331,19 +584,42 @@ void wpool_init_new_search(WorkerPool *wpool) {
     tt_new_search(&wpool->tt);
 
     for (usize i = 0; i < wpool->worker_count; ++i) {
-        atomic_store_explicit(&wpool->worker_list[i]->nodes, 0, memory_order_relaxed);
+        Worker *cur_worker = wpool->worker_list[i];
+
+        cur_worker->nodes = 0;
+        atomic_store_explicit(&cur_worker->published_nodes, 0, memory_order_relaxed);
+#ifdef SEARCH_STATS
+        search_stats_reset(&cur_worker->search_stats);
+#endif
+#ifdef TT_STATS
+        tt_stats_reset(&cur_worker->tt_stats);
+#endif
+
+        if (cur_worker->qcache.table != NULL) {
+            tt_new_search(&cur_worker->qcache);
+        }
+    }
+}
+
+void wpool_wait_search_release(WorkerPool *wpool, bool infinite) {
+    pthread_mutex_lock(&wpool->release_mutex);
+
+    while (!wpool_is_stopped(wpool) && (wpool_is_pondering(wpool) || infinite)) {
+        pthread_cond_wait(&wpool->release_condvar, &wpool->release_mutex);
     }
+
+    pthread_mutex_unlock(&wpool->release_mutex);
 }
 
 void wpool_start_aux_workers(WorkerPool *wpool) {
     for (usize i = 1; i < wpool->worker_count; ++i) {
-        worker_start_searching(wpool->worker_list[i]);
+        worker_start_task(wpool->worker_list[i], WorkerTaskSearch);
     }
 }
 
 void wpool_wait_aux_workers(WorkerPool *wpool) {
     for (usize i = 1; i < wpool->worker_count; ++i) {
-        worker_wait_search_completion(wpool->worker_list[i]);
+        worker_wait_task_completion(wpool->worker_list[i]);
     }
 }
 
@@ -365,12 +641,50 @@ void wpool_check_time(WorkerPool *wpool) {
     }
 }
 
+void wpool_ponderhit(WorkerPool *wpool) {
+    // Update the flag while holding the lock, so that the main thread can't miss the wakeup
+    // between checking the flags and going to sleep.
+    pthread_mutex_lock(&wpool->release_mutex);
+    atomic_store_explicit(&wpool->ponder, false, memory_order_relaxed);
+    pthread_cond_signal(&wpool->release_condvar);
+    pthread_mutex_unlock(&wpool->release_mutex);
+}
+
+void wpool_stop(WorkerPool *wpool) {
+    pthread_mutex_lock(&wpool->release_mutex);
+    atomic_store_explicit(&wpool->stop, true, memory_order_relaxed);
+    pthread_cond_signal(&wpool->release_condvar);
+    pthread_mutex_unlock(&wpool->release_mutex);
+}
+
 u64 wpool_get_total_nodes(const WorkerPool *wpool) {
-    u64 total = 0;
+    // Only the main worker's own counter is read directly here, since the other workers may
+    // still be writing to theirs.
+    u64 total = wpool->worker_list[0]->nodes;
 
-    for (usize i = 0; i < wpool->worker_count; ++i) {
-        total += atomic_load_explicit(&wpool->worker_list[i]->nodes, memory_order_relaxed);
+    for (usize i = 1; i < wpool->worker_count; ++i) {
+        total += atomic_load_explicit(&wpool->worker_list[i]->published_nodes, memory_order_relaxed);
     }
 
     return total;
 }
+
+#ifdef SEARCH_STATS
+void wpool_get_search_stats(const WorkerPool *wpool, SearchStats *stats) {
+    search_stats_reset(stats);
+
+    for (usize i = 0; i < wpool->worker_count; ++i) {
+        search_stats_add(stats, &wpool->worker_list[i]->search_stats);
+    }
+}
+#endif
+
+#ifdef TT_STATS
+void wpool_get_tt_stats(const WorkerPool *wpool, TtStats *stats) {
+    tt_stats_reset(stats);
+
+    for (usize i = 0; i < wpool->worker_count; ++i) {
+        tt_stats_add(stats, &wpool->worker_list[i]->tt_stats);
+    }
+}
+#endif